@@ -5,7 +5,73 @@
  */
 #include "arena.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_MAX_BLOCK (32 * 1024 * 1024)
+#define ARENA_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+#define BLOCK_HEADER ALIGN_UP(sizeof(ArenaBlock), ARENA_ALIGNMENT)
+#define BLOCK_DATA(b) ((char *)(b) + BLOCK_HEADER)
+
+// Mapeia um bloco com pelo menos size bytes utilizáveis
+static ArenaBlock *blockCreate(size_t size) {
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t mapped = ALIGN_UP(BLOCK_HEADER + size, pageSize);
+
+	void *memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+	                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		return NULL;
+
+#ifdef MADV_HUGEPAGE
+	// Blocos grandes podem usar transparent hugepages, se o kernel deixar
+	if (mapped >= ARENA_HUGEPAGE_SIZE)
+		madvise(memory, mapped, MADV_HUGEPAGE);
+#endif
+
+	ArenaBlock *block = (ArenaBlock *)memory;
+	block->previous = NULL;
+	block->size = mapped - BLOCK_HEADER;
+	block->offset = 0;
+	block->mapped = mapped;
+	return block;
+}
+
+static void blockDestroy(ArenaBlock *block) {
+	if (block)
+		munmap(block, block->mapped);
+}
+
+// Coloca um bloco novo no topo da arena
+static bool arenaPushBlock(Arena *arena, size_t length) {
+	ArenaBlock *block = NULL;
+	if (arena->spare && arena->spare->size >= length) {
+		block = arena->spare;
+		arena->spare = NULL;
+	} else {
+		size_t size = arena->blockSize;
+		if (size < length)
+			size = length;
+
+		block = blockCreate(size);
+		if (!block)
+			return false;
+
+		if (arena->blockSize < ARENA_MAX_BLOCK)
+			arena->blockSize *= 2;
+	}
+
+	ArenaBlock *previous = arena->current;
+	block->previous = previous;
+	block->offset = 0;
+	arena->current = block;
+	return true;
+}
 
 // Cria uma arena
 Arena *arenaCreate(size_t initial) {
@@ -14,10 +80,10 @@ Arena *arenaCreate(size_t initial) {
 		return NULL;
 
 	// Inicializar
-	a->buffer = malloc(initial);
-	a->length = initial;
-	a->offset = 0;
-	if (!a->buffer) {
+	a->current = NULL;
+	a->spare = NULL;
+	a->blockSize = initial ? initial : 4096;
+	if (!arenaPushBlock(a, a->blockSize)) {
 		free(a);
 		return NULL;
 	}
@@ -30,40 +96,75 @@ void *arenaAlloc(Arena *arena, size_t length) {
 	if (!arena)
 		return NULL;
 
-	if (arena->offset + length > arena->length) {
-		// Realocar com o novo tamanho
-		size_t newLength = arena->length * 2;
+	ArenaBlock *block = arena->current;
+	size_t offset = ALIGN_UP(block->offset, ARENA_ALIGNMENT);
 
-		if (newLength < arena->offset + length)
-			newLength = arena->offset + length;
-
-		void *newPtr = realloc(arena->buffer, newLength);
-		if (!newPtr)
+	if (offset + length > block->size) {
+		// Bloco novo, os antigos ficam onde estão
+		if (!arenaPushBlock(arena, length))
 			return NULL;
-
-		arena->length = newLength;
-		arena->buffer = newPtr;
+		block = arena->current;
+		offset = 0;
 	}
 
-	void *ptr = arena->buffer + arena->offset;
-	arena->offset += length;
+	void *ptr = BLOCK_DATA(block) + offset;
+	block->offset = offset + length;
 	return ptr;
 }
 
+// Marca a posição atual da arena
+ArenaMark arenaMark(Arena *arena) {
+	ArenaMark mark;
+	mark.block = arena->current;
+	mark.offset = arena->current->offset;
+	return mark;
+}
+
+// Libera tudo que foi alocado depois da marca
+void arenaRelease(Arena *arena, ArenaMark mark) {
+	if (!arena || !mark.block)
+		return;
+
+	while (arena->current != mark.block) {
+		ArenaBlock *block = arena->current;
+		arena->current = block->previous;
+
+		// Guarda um bloco para não ficar mapeando e desmapeando
+		if (arena->spare && arena->spare->size >= block->size) {
+			blockDestroy(block);
+		} else {
+			blockDestroy(arena->spare);
+			arena->spare = block;
+		}
+	}
+
+	arena->current->offset = mark.offset;
+}
+
 // Reseta a Arena
 void arenaReset(Arena *arena) {
 	if (!arena)
 		return;
-	arena->offset = 0;
+
+	ArenaBlock *first = arena->current;
+	while (first->previous)
+		first = first->previous;
+
+	ArenaMark mark = {first, 0};
+	arenaRelease(arena, mark);
 }
 
 // Destroí uma Arena
 void arenaDestroy(Arena *arena) {
 	if (!arena)
 		return;
-	free(arena->buffer);
-	arena->buffer = NULL;
-	arena->length = 0;
-	arena->offset = 0;
+
+	ArenaBlock *block = arena->current;
+	while (block) {
+		ArenaBlock *previous = block->previous;
+		blockDestroy(block);
+		block = previous;
+	}
+	blockDestroy(arena->spare);
 	free(arena);
 }
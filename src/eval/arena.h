@@ -6,13 +6,30 @@
 #pragma once
 #include <stddef.h>
 
-typedef struct Arena {
-	void *buffer;
-	size_t length;
+// Bloco de memória da arena, os dados vêm logo depois do cabeçalho
+typedef struct ArenaBlock {
+	struct ArenaBlock *previous;
+	size_t size; // Bytes utilizáveis
+	size_t offset;
+	size_t mapped; // Tamanho do mmap
+} ArenaBlock;
+
+// Posição na arena, para liberar tudo que veio depois
+typedef struct ArenaMark {
+	ArenaBlock *block;
 	size_t offset;
+} ArenaMark;
+
+// Lista de blocos, a memória entregue nunca se move
+typedef struct Arena {
+	ArenaBlock *current;
+	ArenaBlock *spare; // Último bloco liberado, reaproveitado no próximo
+	size_t blockSize;  // Tamanho do próximo bloco
 } Arena;
 
 Arena *arenaCreate(size_t initial);
 void *arenaAlloc(Arena *arena, size_t length);
+ArenaMark arenaMark(Arena *arena);
+void arenaRelease(Arena *arena, ArenaMark mark);
 void arenaReset(Arena *arena);
 void arenaDestroy(Arena *arena);
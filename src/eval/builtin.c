@@ -0,0 +1,78 @@
+/**
+ * builtin.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "builtin.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../util.h"
+#include "gc.h"
+
+#define KEYBOARD_BUFFER_SIZE 1024
+
+// Tabela de built-ins
+// Usada pelo eval e pela VM
+const Builtin builtins[] = {
+    {"print", 5, builtinPrint},
+    {"input", 5, builtinInput},
+    {"length", 6, builtinLength},
+
+    {NULL, 0, NULL} // Para aqui
+};
+
+// Funções built-in
+Value builtinPrint(Value *args, size_t argc, Arena *arena,
+                   Environment *environment) {
+	(void)arena;
+	(void)environment;
+	for (size_t i = 0; i < argc; i++) {
+		valuePrint(args[i]);
+		if (i < argc - 1)
+			printf(" ");
+	}
+	return null();
+}
+
+Value builtinInput(Value *args, size_t argc, Arena *arena,
+                   Environment *environment) {
+	builtinPrint(args, argc, arena, environment);
+
+	char buffer[KEYBOARD_BUFFER_SIZE];
+	if (fgets(buffer, KEYBOARD_BUFFER_SIZE, stdin) == NULL)
+		return null();
+
+	size_t len = strlen(buffer);
+	if (len > 0 && buffer[len - 1] == '\n') {
+		buffer[len - 1] = 0;
+		len--;
+	}
+
+	String *s = gcString(len);
+	if (!s) {
+		logger(LOG_ERROR, "Internal error: input(): failed to alloc string\n");
+		return errorSignal();
+	}
+	memcpy((char *)s->chars, buffer, len);
+	return string(s);
+}
+
+Value builtinLength(Value *args, size_t argc, Arena *arena,
+                    Environment *environment) {
+	(void)arena;
+	(void)environment;
+	if (argc == 0 || argc > 1) {
+		logger(LOG_ERROR, "Runtime error: length(): invalid arguments\n");
+		return errorSignal();
+	}
+
+	// Por enquanto, só strings
+	if (VALUE_TYPE(args[0]) != VALUE_STRING) {
+		logger(LOG_ERROR, "Runtime error: length(): invalid type\n");
+		return errorSignal();
+	}
+
+	return integer(AS_STRING(args[0])->length);
+}
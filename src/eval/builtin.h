@@ -0,0 +1,27 @@
+/**
+ * builtin.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stddef.h>
+
+#include "arena.h"
+#include "environment.h"
+#include "value.h"
+
+// Built-in com nome
+typedef struct {
+	const char *name;
+	size_t length;
+	BuiltinFunction function;
+} Builtin;
+
+extern const Builtin builtins[];
+
+Value builtinPrint(Value *args, size_t argc, Arena *arena,
+                   Environment *environment);
+Value builtinInput(Value *args, size_t argc, Arena *arena,
+                   Environment *environment);
+Value builtinLength(Value *args, size_t argc, Arena *arena,
+                    Environment *environment);
@@ -8,18 +8,24 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "../util.h"
 
 // Cria um novo Environment
 Environment *environmentCreate(size_t initial, Environment *parent) {
-	Environment *environment = (Environment *)malloc(sizeof(Environment));
+	Environment *environment = (Environment *)calloc(1, sizeof(Environment));
 	if (!environment)
 		return NULL;
 
 	environment->capacity = initial ? initial : 1;
 	environment->count = 0;
 	environment->parent = parent;
+	environment->global = parent ? parent->global : environment;
+	environment->frames = parent ? parent->frames : NULL;
+	environment->object.type = GC_ENVIRONMENT;
+	environment->inFrameStack = false;
+	environment->inlineObjects = false;
 
 	environment->objects =
 	    (Object *)calloc(environment->capacity, sizeof(Object));
@@ -31,52 +37,114 @@ Environment *environmentCreate(size_t initial, Environment *parent) {
 	return environment;
 }
 
+// Aumenta a capacidade de um environment
+static bool environmentGrow(Environment *environment, size_t newCapacity) {
+	Object *newObjects;
+	if (environment->inlineObjects) {
+		// Os objetos estão colados no env, copia para o heap
+		newObjects = (Object *)malloc(newCapacity * sizeof(Object));
+		if (!newObjects)
+			return false;
+		memcpy(newObjects, environment->objects,
+		       environment->capacity * sizeof(Object));
+	} else {
+		newObjects = (Object *)realloc(environment->objects,
+		                               newCapacity * sizeof(Object));
+		if (!newObjects)
+			return false;
+	}
+
+	// Inicializa os novos objetos
+	for (size_t i = environment->capacity; i < newCapacity; i++) {
+		newObjects[i].symbol = SYMBOL_NONE;
+		newObjects[i].value = null();
+	}
+
+	environment->capacity = newCapacity;
+	environment->objects = newObjects;
+	environment->inlineObjects = false;
+	return true;
+}
+
+// Cria um environment que pode ser capturado por funções internas
+// Fica no heap do GC, com os objetos logo depois dele
+Environment *environmentCreateCaptured(size_t slotCount,
+                                       Environment *parent) {
+	Environment *environment = (Environment *)gcAllocate(
+	    GC_ENVIRONMENT, sizeof(Environment) + slotCount * sizeof(Object));
+	if (!environment)
+		return NULL;
+
+	environment->objects = (Object *)(environment + 1);
+	environment->count = 0;
+	environment->capacity = slotCount;
+	environment->parent = parent;
+	environment->global = parent ? parent->global : environment;
+	environment->frames = parent ? parent->frames : NULL;
+	environment->inFrameStack = false;
+	environment->inlineObjects = true;
+	return environment;
+}
+
 // Cria um novo objeto num environment
 bool environmentPushObject(Environment *environment, Object object) {
 	if (!environment) {
 		return false;
 	}
 
-	if (environment->count >= environment->capacity) {
-		size_t newCapacity = environment->capacity * 2;
-		Object *newObjects = (Object *)realloc(environment->objects,
-		                                       newCapacity * sizeof(Object));
-		if (!newObjects) {
-			return false;
-		}
+	if (environment->count >= environment->capacity &&
+	    !environmentGrow(environment, environment->capacity
+	                                      ? environment->capacity * 2
+	                                      : 8))
+		return false;
 
-		// Inicializa os novos objetos
-		for (size_t i = environment->capacity; i < newCapacity; i++) {
-			newObjects[i].start = NULL;
-			newObjects[i].length = 0;
-			newObjects[i].value.type = VALUE_NULL;
-		}
+	environment->objects[environment->count++] = object;
+	return true;
+}
+
+// Define o objeto de um slot calculado pelo resolver
+bool environmentSetSlot(Environment *environment, size_t slot, Object object) {
+	if (!environment)
+		return false;
 
-		environment->capacity = newCapacity;
-		environment->objects = newObjects;
+	if (slot >= environment->capacity) {
+		size_t newCapacity = environment->capacity * 2;
+		if (newCapacity <= slot)
+			newCapacity = slot + 1;
+		if (!environmentGrow(environment, newCapacity))
+			return false;
 	}
 
-	environment->objects[environment->count++] = object;
+	environment->objects[slot] = object;
+	if (slot >= environment->count)
+		environment->count = slot + 1;
 	return true;
 }
 
+// Retorna o Value de um slot
+// NULL se o slot ainda não foi definido
+Value *environmentGetSlot(Environment *environment, size_t slot) {
+	if (slot >= environment->count)
+		return NULL;
+
+	Object *object = &environment->objects[slot];
+	if (object->symbol == SYMBOL_NONE)
+		return NULL;
+	return &object->value;
+}
+
 // Procura um objeto num environment
 // Retorna o ponteiro direto para o Value do objeto
-Value *environmentFindObject(Environment *environment, char *start,
-                             size_t length) {
-	if (!environment || !start || length == 0)
+Value *environmentFindObject(Environment *environment, Symbol symbol) {
+	if (!environment || symbol == SYMBOL_NONE)
 		return NULL;
 
 	Environment *e = environment;
 	while (e) {
 		for (size_t i = e->count; i > 0; i--) {
 			Object *object = &e->objects[i - 1];
-			if (!object->start)
-				continue;
-			if (object->length == length &&
-			    strncmp(start, object->start, length) == 0) {
+			if (object->symbol == symbol)
 				return &object->value;
-			}
 		}
 		e = e->parent;
 	}
@@ -94,3 +162,71 @@ void environmentDestroy(Environment *environment) {
 	free(environment->objects);
 	free(environment);
 }
+
+// Reserva a pilha de frames
+// As páginas só são usadas quando a pilha chega nelas
+FrameStack *frameStackCreate(size_t size) {
+	FrameStack *stack = (FrameStack *)malloc(sizeof(FrameStack));
+	if (!stack)
+		return NULL;
+
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED) {
+		free(stack);
+		return NULL;
+	}
+
+	stack->base = (char *)base;
+	stack->offset = 0;
+	stack->size = size;
+	return stack;
+}
+
+// Empilha um environment com os objetos logo depois dele
+// Retorna NULL se a pilha está cheia
+Environment *frameStackPush(FrameStack *stack, size_t slotCount,
+                            Environment *parent) {
+	if (!stack)
+		return NULL;
+
+	size_t size = sizeof(Environment) + slotCount * sizeof(Object);
+	if (stack->offset + size > stack->size)
+		return NULL;
+
+	Environment *environment = (Environment *)(stack->base + stack->offset);
+	stack->offset += size;
+
+	memset(environment, 0, size);
+	environment->object.type = GC_ENVIRONMENT;
+	environment->objects = (Object *)(environment + 1);
+	environment->count = 0;
+	environment->capacity = slotCount;
+	environment->parent = parent;
+	environment->global = parent ? parent->global : environment;
+	environment->frames = stack;
+	environment->inFrameStack = true;
+	environment->inlineObjects = true;
+	return environment;
+}
+
+// Desempilha o environment do topo e tudo acima dele
+void frameStackPop(FrameStack *stack, Environment *environment) {
+	if (!stack || !environment)
+		return;
+
+	// Cresceu para o heap
+	if (!environment->inlineObjects)
+		free(environment->objects);
+
+	stack->offset = (size_t)((char *)environment - stack->base);
+}
+
+// Destroi a pilha de frames
+void frameStackDestroy(FrameStack *stack) {
+	if (!stack)
+		return;
+
+	munmap(stack->base, stack->size);
+	free(stack);
+}
@@ -4,25 +4,47 @@
  * Licença MIT
  */
 #pragma once
+#include "../symbol.h"
+#include "gc.h"
 #include "value.h"
 #include <stdbool.h>
 #include <stddef.h>
 
+// Variável de um env, SYMBOL_NONE é slot vazio
 typedef struct Object {
-	char *start;
-	size_t length;
+	Symbol symbol;
 	Value value;
 } Object;
 
 typedef struct Environment {
+	GcObject object; // Só os envs capturados estão na lista do GC
 	Object *objects;
 	size_t count;
 	size_t capacity;
 	struct Environment *parent;
+	struct Environment *global; // Raiz da cadeia, guarda as globais
+	struct FrameStack *frames;  // Pilha dos envs de chamada
+	bool inFrameStack;          // Mora na pilha, liberado no frameStackPop
+	bool inlineObjects;         // Objetos logo depois do env, sem malloc
 } Environment;
 
+// Memória contígua para os envs das chamadas que não são capturados
+typedef struct FrameStack {
+	char *base;
+	size_t offset;
+	size_t size;
+} FrameStack;
+
 Environment *environmentCreate(size_t initial, Environment *parent);
+Environment *environmentCreateCaptured(size_t slotCount, Environment *parent);
 bool environmentPushObject(Environment *environment, Object object);
-Value *environmentFindObject(Environment *environment, char *start,
-                             size_t length);
+bool environmentSetSlot(Environment *environment, size_t slot, Object object);
+Value *environmentGetSlot(Environment *environment, size_t slot);
+Value *environmentFindObject(Environment *environment, Symbol symbol);
 void environmentDestroy(Environment *environment);
+
+FrameStack *frameStackCreate(size_t size);
+Environment *frameStackPush(FrameStack *stack, size_t slotCount,
+                            Environment *parent);
+void frameStackPop(FrameStack *stack, Environment *environment);
+void frameStackDestroy(FrameStack *stack);
@@ -3,143 +3,204 @@
  * Criado por Matheus Leme Da Silva
  * Licença MIT
  */
-#include <complex.h>
-#include <math.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../lexer/token.h"
-#include "../parser/ast.h"
+#include "../parser/flat.h"
 #include "arena.h"
+#include "builtin.h"
 #include "eval.h"
+#include "gc.h"
+#include "operator.h"
 
-#define KEYBOARD_BUFFER_SIZE 1024
+// registra builtins caso o env não tenha pai
+void registerBuiltins(Environment *environment) {
+	if (!environment)
+		return;
+	if (environment->parent)
+		return;
 
-// Funções built-in
-Value builtinPrint(Value *args, size_t argc, Arena *arena, Environment *environment) {
-	(void)arena;
-    (void)environment;
-    for (size_t i = 0; i < argc; i++) {
-		valuePrint(args[i]);
-	    if (i < argc - 1)
-            printf(" ");
-    }
-	return null();
+	for (size_t i = 0; builtins[i].name; i++) {
+		Object object;
+		object.symbol = symbolIntern(builtins[i].name, builtins[i].length);
+		object.value = builtinValue(builtins[i].function);
+		environmentSetSlot(environment, i, object); // Mesmo slot do resolver
+	}
 }
 
-Value builtinInput(Value *args, size_t argc, Arena *arena, Environment *environment) {
-    builtinPrint(args, argc, arena, environment); 
+// Ast que está rodando, os filhos são índices no array de nós dela
+static FlatAst *tree = NULL;
+static FlatNode *nodes = NULL;
 
-    char *buffer = arenaAlloc(arena, KEYBOARD_BUFFER_SIZE);  
-    if (fgets(buffer, KEYBOARD_BUFFER_SIZE, stdin) == NULL)
-        return null();
+#define NODE(index) (&nodes[(index)])
 
-    size_t len = strlen(buffer);
-    if (len > 0 && buffer[len - 1] == '\n') {
-        buffer[len - 1] = 0;
-        len--;
-    }
+// Como o último nó terminou
+// Return e erro sobem pelos chamadores, que conferem depois de cada filho
+typedef enum {
+	COMPLETION_NORMAL,
+	COMPLETION_RETURN,    // Valor de retorno é o Value que voltou
+	COMPLETION_TAIL_CALL, // Return de uma chamada, pendente em tailCall
+	COMPLETION_ERROR      // Para o programa
+} Completion;
 
-    Value v;
-    v.type = VALUE_STRING;
-    v.value.string.start = buffer;
-    v.value.string.length = len;
-    return v;
-}
+static Completion completion = COMPLETION_NORMAL;
 
-Value builtinLength(Value *args, size_t argc, Arena *arena, Environment	*environment) {
-	(void)arena;
-	(void)environment;
-	if (argc == 0 || argc > 1) {
-		logger(LOG_ERROR, "Runtime error: length(): invalid arguments\n");
-		return errorSignal();
-	}
+// Chamada de cauda que o evalCall da função atual vai fazer
+typedef struct {
+	FlatNode *node; // NODE_CALL, para erros
+	Value callee;
+	Value *args;
+	uint32_t argc;
+	uint32_t capacity;
+} TailCall;
 
-	// Por enquanto, só strings
-	if (args[0].type != VALUE_STRING) {
-		logger(LOG_ERROR, "Runtime error: length(): invalid type\n");
-		return errorSignal();
-	}
+static TailCall tailCall = {0};
+
+#define ABRUPT() (completion != COMPLETION_NORMAL)
 
-	return integer(args[0].value.string.length);
+// Erro do próprio eval
+static Value evalError(void) {
+	completion = COMPLETION_ERROR;
+	return errorSignal();
 }
 
-// registra builtins caso o env não tenha pai
-void registerBuiltins(Environment *environment) {
-	if (!environment)
-		return;
-	if (environment->parent)
-		return;
+// Confere um valor criado fora do eval (operadores, builtins, alocações)
+static inline Value evalResult(Value value) {
+	if (VALUE_IS_ERROR(value))
+		completion = COMPLETION_ERROR;
+	return value;
+}
 
-	Object object;
-	object.start = "print";
-	object.length = 5;
-	object.value.type = VALUE_FUNCTION_BUILTIN;
-	object.value.value.builtin = builtinPrint;
-	environmentPushObject(environment, object);
-
-	object.start = "input";
-	object.length = 5;
-	object.value.type = VALUE_FUNCTION_BUILTIN;
-	object.value.value.builtin = builtinInput;
-	environmentPushObject(environment, object);
-
-	object.start = "length";
-	object.length = 6;
-	object.value.type = VALUE_FUNCTION_BUILTIN;
-	object.value.value.builtin = builtinLength;
-	environmentPushObject(environment, object);
-}
-
-Value evalProgram(AstNode *root, Arena *arena, Environment *environment);
-Value evalBlockStatement(AstNode *root, Arena *arena, Environment *environment);
-Value evalExpressionStatement(AstNode *root, Arena *arena,
+Value evalNode(FlatNode *root, Arena *arena, Environment *environment);
+Value evalProgram(FlatNode *root, Arena *arena, Environment *environment);
+Value evalBlockStatement(FlatNode *root, Arena *arena,
+                         Environment *environment);
+Value evalExpressionStatement(FlatNode *root, Arena *arena,
                               Environment *environment);
-Value evalReturnStatement(AstNode *root, Arena *arena,
+Value evalReturnStatement(FlatNode *root, Arena *arena,
                           Environment *environment);
-Value evalIfStatement(AstNode *root, Arena *arena, Environment *environment);
-Value evalVarStatement(AstNode *root, Arena *arena, Environment *environment);
-Value evalFnStatement(AstNode *root, Arena *arena, Environment *environment);
-
-Value evalNumber(AstNode *root, Arena *arena, Environment *environment);
-Value evalString(AstNode *root, Arena *arena, Environment *environment);
-Value evalBoolean(AstNode *root, Arena *arena, Environment *environment);
-Value evalIdentifier(AstNode *root, Arena *arena, Environment *environment);
-Value evalAssignment(AstNode *root, Arena *arena, Environment *environment);
-Value evalBinaryOp(AstNode *root, Arena *arena, Environment *environment);
-Value evalUnaryOp(AstNode *root, Arena *arena, Environment *environment);
-Value evalCall(AstNode *root, Arena *arena, Environment *environment);
-
-// Executa uma ast
-Value eval(AstNode *root, Arena *arena, Environment *environment) {
-	Value v = null();
-	registerBuiltins(environment);
+Value evalReturnTailCall(FlatNode *root, Arena *arena,
+                         Environment *environment);
+Value evalIfStatement(FlatNode *root, Arena *arena, Environment *environment);
+Value evalVarStatement(FlatNode *root, Arena *arena, Environment *environment);
+Value evalFnStatement(FlatNode *root, Arena *arena, Environment *environment);
+Value evalWhileStatement(FlatNode *root, Arena *arena,
+                         Environment *environment);
+Value evalForStatement(FlatNode *root, Arena *arena, Environment *environment);
+
+Value evalNumber(FlatNode *root, Arena *arena, Environment *environment);
+Value evalString(FlatNode *root, Arena *arena, Environment *environment);
+Value evalBoolean(FlatNode *root, Arena *arena, Environment *environment);
+Value evalIdentifier(FlatNode *root, Arena *arena, Environment *environment);
+Value evalAssignment(FlatNode *root, Arena *arena, Environment *environment);
+Value evalBinaryOp(FlatNode *root, Arena *arena, Environment *environment);
+Value evalLogical(FlatNode *root, Arena *arena, Environment *environment);
+Value evalConditional(FlatNode *root, Arena *arena, Environment *environment);
+Value evalUnaryOp(FlatNode *root, Arena *arena, Environment *environment);
+Value evalCall(FlatNode *root, Arena *arena, Environment *environment);
+
+Value evalIdentifierLocal(FlatNode *root, Arena *arena,
+                          Environment *environment);
+Value evalIdentifierGlobal(FlatNode *root, Arena *arena,
+                           Environment *environment);
+Value evalBinaryOpQuick(FlatNode *root, Arena *arena,
+                         Environment *environment);
+
+// Execuções seguidas com os mesmos tipos antes de especializar um nó
+#define QUICKEN_THRESHOLD 2
+// Especializações que falharam antes do nó ficar genérico de vez
+#define QUICKEN_MAX_DEOPTS 4
+
+// Procura o Value de um identificador pelo endereço do resolver
+// Slots ainda não definidos caem na busca pelo nome
+static Value *lookup(FlatNode *identifier, Environment *environment) {
+	Value *value = NULL;
+	int depth = identifier->data.identifier.depth;
+	if (depth == RESOLVE_GLOBAL) {
+		value = environmentGetSlot(environment->global,
+		                           identifier->data.identifier.slot);
+	} else if (depth >= 0) {
+		// Sobe pelos links estáticos até a função que declarou
+		Environment *e = environment;
+		for (int i = 0; e && i < depth; i++)
+			e = e->parent;
+		if (e)
+			value = environmentGetSlot(e, identifier->data.identifier.slot);
+	}
+
+	if (value)
+		return value;
+
+	return environmentFindObject(environment,
+	                             identifier->data.identifier.symbol);
+}
+
+// Define um identificador no slot calculado pelo resolver
+static bool define(FlatNode *identifier, Value value,
+                   Environment *environment) {
+	Object object;
+	object.symbol = identifier->data.identifier.symbol;
+	object.value = value;
+
+	Environment *target = environment;
+	if (identifier->data.identifier.depth == RESOLVE_GLOBAL)
+		target = environment->global;
+
+	if (identifier->data.identifier.depth == RESOLVE_DYNAMIC)
+		return environmentPushObject(target, object); // Ast não resolvida
+	return environmentSetSlot(target, identifier->data.identifier.slot,
+	                          object);
+}
+
+// Marca as raízes do eval
+// Os envs das chamadas em andamento estão na pilha de raízes do GC
+static void markRoots(void *data) {
+	gcMarkObject(&((Environment *)data)->object);
+}
 
-	if (!root) {
+// Executa uma ast compacta
+Value eval(FlatAst *ast, Arena *arena, Environment *environment) {
+	if (!ast) {
 		logger(LOG_ERROR,
 		       "Internal error: Failed to execute code: no have ast\n");
-		v.type = VALUE_INTEGER;
-		v.value.integer = -1;
-		return v;
+		return integer(-1);
 	}
 
 	if (!arena) {
 		logger(LOG_ERROR,
 		       "Internal error: Failed to execute code: no have arena\n");
-		v.type = VALUE_INTEGER;
-		v.value.integer = -1;
-		return v;
+		return integer(-1);
 	}
 
 	if (!environment) {
 		logger(LOG_ERROR,
 		       "Internal error: Failed to execute code: no have environment\n");
-		v.type = VALUE_INTEGER;
-		v.value.integer = -1;
-		return v;
+		return integer(-1);
 	}
 
+	tree = ast;
+	nodes = ast->nodes;
+	completion = COMPLETION_NORMAL;
+	Value v = evalNode(NODE(ast->root), arena, environment);
+	if (completion == COMPLETION_ERROR)
+		v = errorSignal();
+	completion = COMPLETION_NORMAL;
+	tree = NULL;
+	nodes = NULL;
+
+	free(tailCall.args);
+	tailCall = (TailCall){0};
+	return v;
+}
+
+// Executa um nó
+Value evalNode(FlatNode *root, Arena *arena, Environment *environment) {
+	Value v = null();
+
 	switch (root->type) {
 	case NODE_PROGRAM: {
 		v = evalProgram(root, arena, environment);
@@ -153,6 +214,9 @@ Value eval(AstNode *root, Arena *arena, Environment *environment) {
 	case NODE_RETURN_STATEMENT: {
 		v = evalReturnStatement(root, arena, environment);
 	} break;
+	case NODE_RETURN_TAIL_CALL: {
+		v = evalReturnTailCall(root, arena, environment);
+	} break;
 	case NODE_IF_STATEMENT: {
 		v = evalIfStatement(root, arena, environment);
 	} break;
@@ -162,6 +226,12 @@ Value eval(AstNode *root, Arena *arena, Environment *environment) {
 	case NODE_FN_STATEMENT: {
 		v = evalFnStatement(root, arena, environment);
 	} break;
+	case NODE_WHILE_STATEMENT: {
+		v = evalWhileStatement(root, arena, environment);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		v = evalForStatement(root, arena, environment);
+	} break;
 	case NODE_NUMBER: {
 		v = evalNumber(root, arena, environment);
 	} break;
@@ -182,560 +252,736 @@ Value eval(AstNode *root, Arena *arena, Environment *environment) {
 	case NODE_BINARYOP: {
 		v = evalBinaryOp(root, arena, environment);
 	} break;
+	case NODE_LOGICAL: {
+		v = evalLogical(root, arena, environment);
+	} break;
+	case NODE_CONDITIONAL: {
+		v = evalConditional(root, arena, environment);
+	} break;
 	case NODE_UNARYOP: {
 		v = evalUnaryOp(root, arena, environment);
 	} break;
 	case NODE_CALL: {
 		v = evalCall(root, arena, environment);
 	} break;
+	case NODE_IDENTIFIER_LOCAL: {
+		v = evalIdentifierLocal(root, arena, environment);
+	} break;
+	case NODE_IDENTIFIER_GLOBAL: {
+		v = evalIdentifierGlobal(root, arena, environment);
+	} break;
+	default: {
+		if (astGenericType(root->type) == NODE_BINARYOP)
+			v = evalBinaryOpQuick(root, arena, environment);
+	} break;
 	}
 
 	return v;
 }
 
 // Program
-Value evalProgram(AstNode *root, Arena *arena, Environment *environment) {
+Value evalProgram(FlatNode *root, Arena *arena, Environment *environment) {
 	Value v = null();
-	for (size_t i = 0; i < root->data.program.count; i++) {
-		v = eval(root->data.program.statements[i], arena, environment);
+	registerBuiltins(environment);
+	gcSetRoots(markRoots, environment->global);
+
+	NodeIndex *statements = &tree->lists[root->data.list.first];
+	for (uint32_t i = 0; i < root->data.list.count; i++) {
+		gcCheckpoint();
+		ArenaMark mark = arenaMark(arena);
+		v = evalNode(NODE(statements[i]), arena, environment);
+		arenaRelease(arena, mark); // Temporários do statement
+		if (ABRUPT())
+			break;
 	}
-	return returnSignalToValue(v); // Para caso o usuario use return direto
+	gcSetRoots(NULL, NULL);
+
+	// Return direto no programa só termina ele
+	if (completion == COMPLETION_RETURN)
+		completion = COMPLETION_NORMAL;
+	return v;
 }
 
 // Block
-Value evalBlockStatement(AstNode *root, Arena *arena,
+Value evalBlockStatement(FlatNode *root, Arena *arena,
                          Environment *environment) {
-	for (size_t i = 0; i < root->data.blockStatement.count; i++) {
-		Value tmp =
-		    eval(root->data.blockStatement.statements[i], arena, environment);
-		if (tmp.type == VALUE_RETURN_SIGNAL) {
-			return tmp;
-		}
+	NodeIndex *statements = &tree->lists[root->data.list.first];
+	for (uint32_t i = 0; i < root->data.list.count; i++) {
+		// Entre statements todo valor vivo está num env ou nas raízes
+		gcCheckpoint();
+		ArenaMark mark = arenaMark(arena);
+		Value tmp = evalNode(NODE(statements[i]), arena, environment);
+		arenaRelease(arena, mark);
+		if (ABRUPT())
+			return tmp; // Return ou erro, sobe até o evalCall
+
 	}
 	return null();
 }
 
 // Expression
-Value evalExpressionStatement(AstNode *root, Arena *arena,
+Value evalExpressionStatement(FlatNode *root, Arena *arena,
                               Environment *environment) {
-	return eval(root->data.expressionStatement.expression, arena, environment);
+	return evalNode(NODE(root->data.operand), arena, environment);
 }
 
 // Return
-Value evalReturnStatement(AstNode *root, Arena *arena,
+Value evalReturnStatement(FlatNode *root, Arena *arena,
                           Environment *environment) {
-	return returnSignal(
-	    returnSignalToValue(
-	        eval(root->data.returnStatement.statement, arena, environment)),
-	    arena);
+	Value value = evalNode(NODE(root->data.operand), arena, environment);
+	if (!ABRUPT())
+		completion = COMPLETION_RETURN;
+	return value;
+}
+
+// Return de uma chamada dentro de função
+// Só avalia callee e args: quem chama é o evalCall da função atual,
+// trocando de frame em vez de empilhar outro
+Value evalReturnTailCall(FlatNode *root, Arena *arena,
+                         Environment *environment) {
+	FlatNode *call = NODE(NODE(root->data.operand)->data.operand);
+	size_t roots = gcRootCount();
+
+	Value callee = evalNode(NODE(call->data.call.callee), arena, environment);
+	if (ABRUPT())
+		return callee;
+	gcPushRoot(callee);
+
+	// Os args vão para a arena: chamadas dentro deles usam o tailCall
+	NodeIndex *argNodes = &tree->lists[call->data.call.args];
+	uint32_t argc = call->data.call.argc;
+	Value *args = arenaAlloc(arena, sizeof(Value) * argc);
+	for (uint32_t i = 0; i < argc; i++) {
+		args[i] = evalNode(NODE(argNodes[i]), arena, environment);
+		if (ABRUPT()) {
+			gcRestoreRoots(roots);
+			return args[i];
+		}
+		gcPushRoot(args[i]);
+	}
+	gcRestoreRoots(roots);
+
+	if (argc > tailCall.capacity) {
+		Value *buffer = (Value *)realloc(tailCall.args, argc * sizeof(Value));
+		if (!buffer) {
+			logger(LOG_ERROR, "Internal error: Failed to alloc arguments\n");
+			return evalError();
+		}
+		tailCall.args = buffer;
+		tailCall.capacity = argc;
+	}
+
+	// Daqui até o evalCall nada aloca, não precisa de raízes
+	tailCall.node = call;
+	tailCall.callee = callee;
+	tailCall.argc = argc;
+	if (argc)
+		memcpy(tailCall.args, args, argc * sizeof(Value));
+	completion = COMPLETION_TAIL_CALL;
+	return null();
 }
 
 // If
-Value evalIfStatement(AstNode *root, Arena *arena, Environment *environment) {
+Value evalIfStatement(FlatNode *root, Arena *arena, Environment *environment) {
 	Value condition =
-	    eval(root->data.ifStatement.condition, arena, environment);
+	    evalNode(NODE(root->data.ifStatement.condition), arena, environment);
+	if (ABRUPT())
+		return condition;
 
-	Value ret;
+	Value ret = null();
 	if (isTrue(condition)) {
-		ret = eval(root->data.ifStatement.thenBranch, arena, environment);
-	} else {
-		ret = eval(root->data.ifStatement.elseBranch, arena, environment);
+		ret = evalNode(NODE(root->data.ifStatement.thenBranch), arena,
+		               environment);
+	} else if (root->data.ifStatement.elseBranch) {
+		ret = evalNode(NODE(root->data.ifStatement.elseBranch), arena,
+		               environment);
 	}
 
-	return returnSignalToValue(ret);
+	return ret; // Num return, o valor precisa subir até o evalCall
 }
 
 // Var
-Value evalVarStatement(AstNode *root, Arena *arena, Environment *environment) {
-	Object variable;
-	variable.start =
-	    (char *)root->data.varStatement.identifier->data.identifier.name;
-	variable.length =
-	    root->data.varStatement.identifier->data.identifier.length;
-	variable.value =
-	    eval(root->data.varStatement.expression, arena, environment);
-
-	if (variable.value.type == VALUE_ERROR_SIGNAL)
-		return errorSignal();
+Value evalVarStatement(FlatNode *root, Arena *arena, Environment *environment) {
+	Value value =
+	    evalNode(NODE(root->data.varStatement.expression), arena, environment);
 
-	if (!environmentPushObject(environment, variable)) {
+	if (ABRUPT())
+		return value;
+
+	if (!define(NODE(root->data.varStatement.identifier), value,
+	            environment)) {
 		logger(LOG_ERROR, "Internal error: Failed to push variable\n");
-		return errorSignal();
+		return evalError();
 	}
 
 	return null();
 }
 
 // Fn
-Value evalFnStatement(AstNode *root, Arena *arena, Environment *environment) {
+Value evalFnStatement(FlatNode *root, Arena *arena, Environment *environment) {
 	(void)arena;
-	Object object;
-	object.start =
-	    (char *)root->data.fnStatement.functionName->data.identifier.name;
-	object.length = root->data.fnStatement.functionName->data.identifier.length;
-	object.value = function(root);
+	FlatFunction *fn = &tree->functions[root->data.function];
+	Value value = evalResult(function(fn, environment));
 
-	if (!environmentPushObject(environment, object)) {
+	if (!define(NODE(fn->name), value, environment)) {
 		logger(LOG_ERROR, "Internal error: Failed to push function\n");
-		return errorSignal();
+		return evalError();
+	}
+
+	return value;
+}
+
+// While
+Value evalWhileStatement(FlatNode *root, Arena *arena,
+                         Environment *environment) {
+	FlatNode *condition = NODE(root->data.whileStatement.condition);
+	FlatNode *statement = NODE(root->data.whileStatement.statement);
+
+	for (;;) {
+		// Entre iterações todo valor vivo está num env ou nas raízes
+		gcCheckpoint();
+		ArenaMark mark = arenaMark(arena);
+		Value test = evalNode(condition, arena, environment);
+		if (ABRUPT())
+			return test;
+		arenaRelease(arena, mark);
+		if (!isTrue(test))
+			return null();
+
+		Value v = evalNode(statement, arena, environment);
+		arenaRelease(arena, mark);
+		if (ABRUPT())
+			return v; // Return ou erro, sobe até o evalCall
+	}
+}
+
+// For
+// O contador é um long long do C: o slot da variável só recebe uma cópia a
+// cada volta, então mudar a variável no corpo não muda a contagem
+Value evalForStatement(FlatNode *root, Arena *arena, Environment *environment) {
+	NodeIndex *parts = &tree->lists[root->data.forStatement.parts];
+	FlatNode *identifier = NODE(parts[0]);
+	FlatNode *statement = NODE(parts[3]);
+
+	Value start = evalNode(NODE(parts[1]), arena, environment);
+	if (ABRUPT())
+		return start;
+	Value end = evalNode(NODE(parts[2]), arena, environment);
+	if (ABRUPT())
+		return end;
+
+	if (VALUE_TYPE(start) != VALUE_INTEGER ||
+	    VALUE_TYPE(end) != VALUE_INTEGER) {
+		tokenLogger(LOG_ERROR, flatToken(tree, root),
+		            "Runtime error: Range bounds must be integers");
+		return evalError();
+	}
+
+	long long last = AS_INTEGER(end);
+	for (long long i = AS_INTEGER(start); i < last; i++) {
+		gcCheckpoint();
+		ArenaMark mark = arenaMark(arena);
+
+		// Direto no slot do resolver, sem procurar pelo nome
+		Value counter = evalResult(integer(i));
+		if (ABRUPT())
+			return counter;
+		if (!define(identifier, counter, environment)) {
+			logger(LOG_ERROR, "Internal error: Failed to push variable\n");
+			return evalError();
+		}
+
+		Value v = evalNode(statement, arena, environment);
+		arenaRelease(arena, mark);
+		if (ABRUPT())
+			return v;
 	}
 
-	return object.value;
+	return null();
 }
 
 // Number
-Value evalNumber(AstNode *root, Arena *arena, Environment *environment) {
+Value evalNumber(FlatNode *root, Arena *arena, Environment *environment) {
 	(void)arena;
 	(void)environment;
 	Value v = null();
+#ifdef VUL_NANBOX
+	// O Value cabe no lugar do número: um inteiro que iria para o heap é
+	// criado uma vez, como os literais de string, e não a cada execução
+	if (root->data.number.cached) {
+		memcpy(&v, root->data.number.bits, sizeof(v));
+		return v;
+	}
+#endif
+
+	TokenNumber number = flatNumber(root);
 	if (root->data.number.isFloat) {
-		v = floating(root->data.number.value.floating);
+		v = floating(number.floating);
 	} else {
-		v = integer(root->data.number.value.integer);
+#ifdef VUL_NANBOX
+		v = integerLiteral(number.integer);
+		if (VALUE_TYPE(v) == VALUE_ERROR_SIGNAL)
+			return evalError();
+		memcpy(root->data.number.bits, &v, sizeof(v));
+		root->data.number.cached = 1;
+#else
+		v = evalResult(integer(number.integer));
+#endif
 	}
 	return v;
 }
 
 // String
-Value evalString(AstNode *root, Arena *arena, Environment *environment) {
+Value evalString(FlatNode *root, Arena *arena, Environment *environment) {
 	(void)arena;
 	(void)environment;
-	return string(root->data.string.start, root->data.string.length);
+	// O literal é criado uma vez e reaproveitado
+	FlatString *literal = &tree->strings[root->data.string];
+	if (!literal->literal)
+		literal->literal = gcLiteral(literal->start, literal->length);
+	if (!literal->literal) {
+		logger(LOG_ERROR, "Internal error: Failed to alloc string\n");
+		return evalError();
+	}
+	return string(literal->literal);
 }
 
 // Boolean
-Value evalBoolean(AstNode *root, Arena *arena, Environment *environment) {
+Value evalBoolean(FlatNode *root, Arena *arena, Environment *environment) {
 	(void)arena;
 	(void)environment;
-	return boolean(root->data.boolean.value);
+	return boolean(root->data.boolean);
 }
 
 // Identifier
-Value evalIdentifier(AstNode *root, Arena *arena, Environment *environment) {
+Value evalIdentifier(FlatNode *root, Arena *arena, Environment *environment) {
 	(void)arena;
-	Value *value =
-	    environmentFindObject(environment, (char *)root->data.identifier.name,
-	                          root->data.identifier.length);
+	Value *value = lookup(root, environment);
 	if (!value) {
-		tokenLogger(LOG_ERROR, *root->token,
+		tokenLogger(LOG_ERROR, flatToken(tree, root),
 		            "Runtime error: Undefined reference: %.*s\n",
-		            root->data.identifier.length, root->data.identifier.name);
-		return errorSignal();
+		            (int)symbolLength(root->data.identifier.symbol),
+		            symbolName(root->data.identifier.symbol));
+		return evalError();
 	}
 
+	// Achou pelo slot: as próximas leituras vão direto nele
+	int depth = root->data.identifier.depth;
+	size_t slot = root->data.identifier.slot;
+	if (depth == 0 && value == environmentGetSlot(environment, slot))
+		root->type = NODE_IDENTIFIER_LOCAL;
+	else if (depth == RESOLVE_GLOBAL &&
+	         value == environmentGetSlot(environment->global, slot))
+		root->type = NODE_IDENTIFIER_GLOBAL;
+
 	return *value;
 }
 
+// Identifier especializado: local da função atual
+Value evalIdentifierLocal(FlatNode *root, Arena *arena,
+                          Environment *environment) {
+	size_t slot = root->data.identifier.slot;
+	if (slot < environment->count && environment->objects[slot].symbol)
+		return environment->objects[slot].value;
+
+	root->type = NODE_IDENTIFIER; // Slot ainda não definido nesse env
+	return evalIdentifier(root, arena, environment);
+}
+
+// Identifier especializado: global
+Value evalIdentifierGlobal(FlatNode *root, Arena *arena,
+                           Environment *environment) {
+	Environment *global = environment->global;
+	size_t slot = root->data.identifier.slot;
+	if (slot < global->count && global->objects[slot].symbol)
+		return global->objects[slot].value;
+
+	root->type = NODE_IDENTIFIER;
+	return evalIdentifier(root, arena, environment);
+}
+
 // Assignment
-Value evalAssignment(AstNode *root, Arena *arena, Environment *environment) {
-	Value *v = environmentFindObject(
-	    environment, (char *)root->data.assigment.target->data.identifier.name,
-	    root->data.assigment.target->data.identifier.length);
+Value evalAssignment(FlatNode *root, Arena *arena, Environment *environment) {
+	// O valor vem antes: uma chamada nele pode mover os objetos do env
+	Value value =
+	    evalNode(NODE(root->data.assignment.value), arena, environment);
+	if (ABRUPT())
+		return value;
+
+	FlatNode *target = NODE(root->data.assignment.target);
+	Value *v = lookup(target, environment);
 	if (!v) {
-		tokenLogger(LOG_ERROR, *root->data.assigment.target->token,
+		Symbol symbol = target->data.identifier.symbol;
+		tokenLogger(LOG_ERROR, flatToken(tree, target),
 		            "Runtime error: Undefined reference: %.*s\n",
-		            root->data.assigment.target->data.identifier.length,
-		            root->data.assigment.target->data.identifier.name);
-		return errorSignal();
+		            (int)symbolLength(symbol), symbolName(symbol));
+		return evalError();
 	}
 
-	*v = eval(root->data.assigment.value, arena, environment);
+	*v = value;
 
 	return null();
 }
 
-// BinaryOp
-Value evalBinaryOp(AstNode *root, Arena *arena, Environment *environment) {
-	Value v;
-
-	Value left = eval(root->data.binaryOp.left, arena, environment);
-	Value right = eval(root->data.binaryOp.right, arena, environment);
-	if (root->data.binaryOp.op == TOKEN_OR) {
-		v = boolean(isTrue(left) || isTrue(right));
-	} else if (root->data.binaryOp.op == TOKEN_AND) {
-		v = boolean(isTrue(left) && isTrue(right));
-	} else if (root->data.binaryOp.op == TOKEN_BIT_OR) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer | right.value.integer);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Bitwise or with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_BIT_XOR) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer ^ right.value.integer);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Bitwise xor with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_BIT_AND) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer & right.value.integer);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Bitwise and with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_EQ) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.integer == right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = boolean(left.value.floating == right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.floating == (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = boolean((double)left.value.integer == right.value.floating);
-		} else if (left.type == VALUE_STRING && right.type == VALUE_STRING) {
-			if (left.value.string.length != right.value.string.length) {
-				v = boolean(false);
-			} else {
-				v = boolean(strncmp(left.value.string.start,
-				                    right.value.string.start,
-				                    left.value.string.length) == 0);
-			}
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Comparison with incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_NEQ) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.integer != right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = boolean(left.value.floating != right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.floating != (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = boolean((double)left.value.integer != right.value.floating);
-		} else if (left.type == VALUE_STRING && right.type == VALUE_STRING) {
-			if (left.value.string.length != right.value.string.length) {
-				v = boolean(true);
-			} else {
-				v = boolean(strncmp(left.value.string.start,
-				                    right.value.string.start,
-				                    left.value.string.length) != 0);
-			}
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Comparison with incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_LT) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.integer < right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = boolean(left.value.floating < right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.floating < (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = boolean((double)left.value.integer < right.value.floating);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Comparison with incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_GT) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.integer > right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = boolean(left.value.floating > right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.floating > (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = boolean((double)left.value.integer > right.value.floating);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Comparison with incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_LTE) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.integer <= right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = boolean(left.value.floating <= right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.floating <= (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = boolean((double)left.value.integer <= right.value.floating);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Comparison with incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_GTE) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.integer >= right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = boolean(left.value.floating >= right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = boolean(left.value.floating >= (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = boolean((double)left.value.integer >= right.value.floating);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Comparison with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_SHIFT_LEFT) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer << right.value.integer);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Shift with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_SHIFT_RIGHT) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer >> right.value.integer);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Shift with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_PLUS) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer + right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = floating(left.value.floating + right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = floating(left.value.floating + (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = floating((double)left.value.integer + right.value.floating);
-		} else if (left.type == VALUE_STRING && right.type == VALUE_STRING) {
-			size_t newLength =
-			    left.value.string.length + right.value.string.length;
-			char *start = (char *)arenaAlloc(arena, newLength);
-			memcpy(start, left.value.string.start, left.value.string.length);
-			memcpy(start + left.value.string.length, right.value.string.start,
-			       right.value.string.length);
-			v = string(start, newLength);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Sum with incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_MINUS) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer - right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = floating(left.value.floating - right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = floating(left.value.floating - (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = floating((double)left.value.integer - right.value.floating);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Subtraction with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_STAR) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			v = integer(left.value.integer * right.value.integer);
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			v = floating(left.value.floating * right.value.floating);
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			v = floating(left.value.floating * (double)right.value.integer);
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			v = floating((double)left.value.integer * right.value.floating);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Multiplication with "
-			            "incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_SLASH) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			if (right.value.integer == 0) {
-				if (root->token)
-					tokenLogger(LOG_ERROR, *root->token,
-					            "Runtime error: Division by zero");
-				return errorSignal();
-			} else {
-				return integer(left.value.integer / right.value.integer);
-			}
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			if (right.value.floating == 0.0f) {
-				tokenLogger(LOG_ERROR, *root->token,
-				            "Runtime error: Division by zero");
-				return errorSignal();
-			} else {
-				return floating(left.value.floating / right.value.floating);
-			}
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			if (right.value.integer == 0) {
-				tokenLogger(LOG_ERROR, *root->token,
-				            "Runtime error: Division by zero");
-				return errorSignal();
-			} else {
-				return floating(left.value.floating /
-				                (double)right.value.integer);
-			}
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			if (right.value.floating == 0.0f) {
-				tokenLogger(LOG_ERROR, *root->token,
-				            "Runtime error: Division by zero");
-				return errorSignal();
-			} else {
-				return floating((double)left.value.integer /
-				                right.value.floating);
-			}
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Division with incompatible types");
-			return errorSignal();
-		}
-	} else if (root->data.binaryOp.op == TOKEN_PERCENT) {
-		if (left.type == VALUE_INTEGER && right.type == VALUE_INTEGER) {
-			if (right.value.integer == 0) {
-				tokenLogger(LOG_ERROR, *root->token,
-				            "Runtime error: Module by zero");
-				return errorSignal();
-			} else {
-				return integer(left.value.integer % right.value.integer);
-			}
-		} else if (left.type == VALUE_FLOATING &&
-		           right.type == VALUE_FLOATING) {
-			if (right.value.floating == 0.0f) {
-				tokenLogger(LOG_ERROR, *root->token,
-				            "Runtime error: Module by zero");
-				return errorSignal();
-			} else {
-				return floating(
-				    fmod(left.value.floating, right.value.floating));
-			}
-		} else if (left.type == VALUE_FLOATING && right.type == VALUE_INTEGER) {
-			if (right.value.integer == 0) {
-				tokenLogger(LOG_ERROR, *root->token,
-				            "Runtime error: Module by zero");
-
-				return errorSignal();
-			} else {
-				return floating(
-				    fmod(left.value.floating, (double)right.value.integer));
-			}
-		} else if (left.type == VALUE_INTEGER && right.type == VALUE_FLOATING) {
-			if (right.value.floating == 0.0f) {
-				tokenLogger(LOG_ERROR, *root->token,
-				            "Runtime error: Module by zero");
-				return errorSignal();
-			} else {
-				return floating(
-				    fmod((double)left.value.integer, right.value.floating));
-			}
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Module with incompatible types");
-			return errorSignal();
-		}
+// Avalia os dois lados de um BinaryOp
+// Retorna false se um deles deu erro
+static inline bool evalOperands(FlatNode *root, Arena *arena,
+                                Environment *environment, Value *left,
+                                Value *right) {
+	*left = evalNode(NODE(root->data.binaryOp.left), arena, environment);
+	if (ABRUPT())
+		return false;
+
+	// O lado direito pode rodar statements e coletar
+	size_t roots = gcRootCount();
+	gcPushRoot(*left);
+	*right = evalNode(NODE(root->data.binaryOp.right), arena, environment);
+	gcRestoreRoots(roots);
+	return !ABRUPT();
+}
+
+// Nó especializado para um operador com dois inteiros
+static NodeType quickIntNode(TokenType op) {
+	switch (op) {
+	case TOKEN_PLUS:
+		return NODE_BINARYOP_ADD_INT;
+	case TOKEN_MINUS:
+		return NODE_BINARYOP_SUB_INT;
+	case TOKEN_STAR:
+		return NODE_BINARYOP_MUL_INT;
+	case TOKEN_SLASH:
+		return NODE_BINARYOP_DIV_INT;
+	case TOKEN_PERCENT:
+		return NODE_BINARYOP_MOD_INT;
+	case TOKEN_EQ:
+		return NODE_BINARYOP_EQ_INT;
+	case TOKEN_NEQ:
+		return NODE_BINARYOP_NEQ_INT;
+	case TOKEN_LT:
+		return NODE_BINARYOP_LT_INT;
+	case TOKEN_GT:
+		return NODE_BINARYOP_GT_INT;
+	case TOKEN_LTE:
+		return NODE_BINARYOP_LTE_INT;
+	case TOKEN_GTE:
+		return NODE_BINARYOP_GTE_INT;
+	default:
+		return NODE_BINARYOP;
 	}
+}
 
-	return v;
+// Nó especializado para um operador com dois floats
+static NodeType quickFloatNode(TokenType op) {
+	switch (op) {
+	case TOKEN_PLUS:
+		return NODE_BINARYOP_ADD_FLOAT;
+	case TOKEN_MINUS:
+		return NODE_BINARYOP_SUB_FLOAT;
+	case TOKEN_STAR:
+		return NODE_BINARYOP_MUL_FLOAT;
+	case TOKEN_LT:
+		return NODE_BINARYOP_LT_FLOAT;
+	case TOKEN_GT:
+		return NODE_BINARYOP_GT_FLOAT;
+	case TOKEN_LTE:
+		return NODE_BINARYOP_LTE_FLOAT;
+	case TOKEN_GTE:
+		return NODE_BINARYOP_GTE_FLOAT;
+	default:
+		return NODE_BINARYOP;
+	}
 }
 
-// UnaryOp
-Value evalUnaryOp(AstNode *root, Arena *arena, Environment *environment) {
-	Value v = null();
-	Value operand = eval(root->data.unaryOp.operand, arena, environment);
-	TokenType op = root->data.unaryOp.op;
-
-	if (op == TOKEN_PLUS) {
-		if (operand.type == VALUE_INTEGER) {
-			v = integer(operand.value.integer);
-		} else if (operand.type == VALUE_FLOATING) {
-			v = floating(operand.value.floating);
-		} else {
-			tokenLogger(
-			    LOG_ERROR, *root->token,
-			    "Runtime error: Unary plus operator with incompatible type\n");
-			return errorSignal();
-		}
-	} else if (op == TOKEN_MINUS) {
-		if (operand.type == VALUE_INTEGER) {
-			v = integer(-operand.value.integer);
-		} else if (operand.type == VALUE_FLOATING) {
-			v = floating(-operand.value.floating);
-		} else {
-			tokenLogger(
-			    LOG_ERROR, *root->token,
-			    "Runtime error: Unary minus operator with incompatible type\n");
-			return errorSignal();
-		}
-	} else if (op == TOKEN_BIT_NOT) {
-		if (operand.type == VALUE_INTEGER) {
-			v = integer(~operand.value.integer);
-		} else {
-			tokenLogger(LOG_ERROR, *root->token,
-			            "Runtime error: Unary bitwise not operator with "
-			            "incompatible type\n");
-			return errorSignal();
-		}
+// Junta o feedback de tipos e especializa o nó quando estabiliza
+static void quickenBinaryOp(FlatNode *root, Value left, Value right) {
+	TypeFeedback *feedback = &root->data.binaryOp.feedback;
+	if (feedback->deopts >= QUICKEN_MAX_DEOPTS)
+		return;
+
+	NodeType quick = NODE_BINARYOP;
+	if (VALUE_TYPE(left) == VALUE_INTEGER && VALUE_TYPE(right) == VALUE_INTEGER)
+		quick = quickIntNode(root->op);
+	else if (VALUE_TYPE(left) == VALUE_FLOATING &&
+	         VALUE_TYPE(right) == VALUE_FLOATING)
+		quick = quickFloatNode(root->op);
+
+	uint8_t seen = (uint8_t)(quick - NODE_BINARYOP);
+	if (quick == NODE_BINARYOP || seen != feedback->seen) {
+		feedback->seen = seen;
+		feedback->hits = 0;
 	}
+	if (quick != NODE_BINARYOP && ++feedback->hits >= QUICKEN_THRESHOLD)
+		root->type = (uint8_t)quick;
+}
 
-	return v;
+// BinaryOp
+Value evalBinaryOp(FlatNode *root, Arena *arena, Environment *environment) {
+	Value left, right;
+	if (!evalOperands(root, arena, environment, &left, &right))
+		return errorSignal();
+
+	quickenBinaryOp(root, left, right);
+	return evalResult(
+	    operatorBinary(root->op, left, right, flatToken(tree, root)));
 }
 
-// Call
-Value evalCall(AstNode *root, Arena *arena, Environment *environment) {
-	Value callee = eval(root->data.call.callee, arena, environment);
+// Volta um nó especializado para o genérico e aplica o operador
+static Value deoptBinaryOp(FlatNode *root, Value left, Value right) {
+	root->type = NODE_BINARYOP;
+	root->data.binaryOp.feedback.hits = 0;
+	root->data.binaryOp.feedback.deopts++;
+	return evalResult(
+	    operatorBinary(root->op, left, right, flatToken(tree, root)));
+}
 
-	Value *args = arenaAlloc(arena, sizeof(Value) * root->data.call.argc);
-	for (size_t i = 0; i < root->data.call.argc; i++) {
-		args[i] = eval(root->data.call.args[i], arena, environment);
+// Divisão int/int que o C faz sem erro
+// Divisor 0 e LLONG_MIN / -1 ficam para o genérico
+static inline bool quickDivisible(long long left, long long right) {
+	return right != 0 && !(right == -1 && left == LLONG_MIN);
+}
+
+// BinaryOp especializado: confere as tags e faz a conta direto
+// Overflow e divisão inválida voltam para o genérico, que reporta o erro
+Value evalBinaryOpQuick(FlatNode *root, Arena *arena,
+                         Environment *environment) {
+	Value left, right;
+	if (!evalOperands(root, arena, environment, &left, &right))
+		return errorSignal();
+
+	bool ints =
+	    VALUE_TYPE(left) == VALUE_INTEGER && VALUE_TYPE(right) == VALUE_INTEGER;
+	bool floats = VALUE_TYPE(left) == VALUE_FLOATING &&
+	              VALUE_TYPE(right) == VALUE_FLOATING;
+
+	long long result;
+	switch (root->type) {
+	case NODE_BINARYOP_ADD_INT:
+		if (ints && !__builtin_add_overflow(AS_INTEGER(left),
+		                                    AS_INTEGER(right), &result))
+			return evalResult(integer(result));
+		break;
+	case NODE_BINARYOP_SUB_INT:
+		if (ints && !__builtin_sub_overflow(AS_INTEGER(left),
+		                                    AS_INTEGER(right), &result))
+			return evalResult(integer(result));
+		break;
+	case NODE_BINARYOP_MUL_INT:
+		if (ints && !__builtin_mul_overflow(AS_INTEGER(left),
+		                                    AS_INTEGER(right), &result))
+			return evalResult(integer(result));
+		break;
+	case NODE_BINARYOP_DIV_INT:
+		if (ints && quickDivisible(AS_INTEGER(left), AS_INTEGER(right)))
+			return evalResult(integer(AS_INTEGER(left) / AS_INTEGER(right)));
+		break;
+	case NODE_BINARYOP_MOD_INT:
+		if (ints && quickDivisible(AS_INTEGER(left), AS_INTEGER(right)))
+			return evalResult(integer(AS_INTEGER(left) % AS_INTEGER(right)));
+		break;
+	case NODE_BINARYOP_EQ_INT:
+		if (ints)
+			return boolean(AS_INTEGER(left) == AS_INTEGER(right));
+		break;
+	case NODE_BINARYOP_NEQ_INT:
+		if (ints)
+			return boolean(AS_INTEGER(left) != AS_INTEGER(right));
+		break;
+	case NODE_BINARYOP_LT_INT:
+		if (ints)
+			return boolean(AS_INTEGER(left) < AS_INTEGER(right));
+		break;
+	case NODE_BINARYOP_GT_INT:
+		if (ints)
+			return boolean(AS_INTEGER(left) > AS_INTEGER(right));
+		break;
+	case NODE_BINARYOP_LTE_INT:
+		if (ints)
+			return boolean(AS_INTEGER(left) <= AS_INTEGER(right));
+		break;
+	case NODE_BINARYOP_GTE_INT:
+		if (ints)
+			return boolean(AS_INTEGER(left) >= AS_INTEGER(right));
+		break;
+	case NODE_BINARYOP_ADD_FLOAT:
+		if (floats)
+			return floating(AS_FLOATING(left) + AS_FLOATING(right));
+		break;
+	case NODE_BINARYOP_SUB_FLOAT:
+		if (floats)
+			return floating(AS_FLOATING(left) - AS_FLOATING(right));
+		break;
+	case NODE_BINARYOP_MUL_FLOAT:
+		if (floats)
+			return floating(AS_FLOATING(left) * AS_FLOATING(right));
+		break;
+	case NODE_BINARYOP_LT_FLOAT:
+		if (floats)
+			return boolean(AS_FLOATING(left) < AS_FLOATING(right));
+		break;
+	case NODE_BINARYOP_GT_FLOAT:
+		if (floats)
+			return boolean(AS_FLOATING(left) > AS_FLOATING(right));
+		break;
+	case NODE_BINARYOP_LTE_FLOAT:
+		if (floats)
+			return boolean(AS_FLOATING(left) <= AS_FLOATING(right));
+		break;
+	case NODE_BINARYOP_GTE_FLOAT:
+		if (floats)
+			return boolean(AS_FLOATING(left) >= AS_FLOATING(right));
+		break;
+	default:
+		break;
 	}
 
-	Value result;
+	return deoptBinaryOp(root, left, right);
+}
+
+// Logical
+// O lado direito só roda se o esquerdo não decidir o resultado
+Value evalLogical(FlatNode *root, Arena *arena, Environment *environment) {
+	Value left = evalNode(NODE(root->data.binaryOp.left), arena, environment);
+	if (ABRUPT())
+		return left;
+
+	bool truth = isTrue(left);
+	if (root->op == TOKEN_AND ? !truth : truth)
+		return boolean(truth);
+
+	Value right = evalNode(NODE(root->data.binaryOp.right), arena, environment);
+	if (ABRUPT())
+		return right;
+	return boolean(isTrue(right));
+}
+
+// Conditional
+// Só o lado escolhido roda
+Value evalConditional(FlatNode *root, Arena *arena, Environment *environment) {
+	Value condition =
+	    evalNode(NODE(root->data.ifStatement.condition), arena, environment);
+	if (ABRUPT())
+		return condition;
+
+	NodeIndex branch = isTrue(condition) ? root->data.ifStatement.thenBranch
+	                                     : root->data.ifStatement.elseBranch;
+	return evalNode(NODE(branch), arena, environment);
+}
+
+// UnaryOp
+Value evalUnaryOp(FlatNode *root, Arena *arena, Environment *environment) {
+	Value operand = evalNode(NODE(root->data.operand), arena, environment);
+	if (ABRUPT())
+		return operand;
+
+	return evalResult(operatorUnary(root->op, operand, flatToken(tree, root)));
+}
 
-	if (callee.type == VALUE_FUNCTION_DEFINITION) {
+// Chama uma função com os args já avaliados
+// Chamadas de cauda da função rodam aqui, no mesmo loop: o frame dela sai
+// antes do próximo entrar, então a pilha não cresce
+static Value evalApply(FlatNode *root, Value callee, Value *args,
+                       uint32_t argc, Arena *arena, Environment *environment) {
+	size_t roots = gcRootCount();
 
-		AstNode *fn = callee.value.function;
+	for (;;) {
+		if (VALUE_TYPE(callee) == VALUE_FUNCTION_BUILTIN)
+			return evalResult(
+			    AS_BUILTIN(callee)(args, argc, arena, environment));
 
-		if (root->data.call.argc != fn->data.fnStatement.paramCount) {
-			tokenLogger(LOG_ERROR, *root->token,
+		if (VALUE_TYPE(callee) != VALUE_FUNCTION_DEFINITION) {
+			tokenLogger(
+			    LOG_ERROR, flatToken(tree, root),
+			    "Runtime error: Called something that isn't a function");
+			return evalError();
+		}
+
+		FlatFunction *fn = AS_FUNCTION_DEFINITION(callee);
+
+		if (argc != fn->paramCount) {
+			tokenLogger(LOG_ERROR, flatToken(tree, root),
 			            "Runtime error: Invalid parameters");
-			return errorSignal();
+			return evalError();
 		}
 
-		Environment *functionEnvironment = environmentCreate(8, environment);
-		for (size_t i = 0; i < fn->data.fnStatement.paramCount; i++) {
-			Object object;
-			object.start =
-			    (char *)fn->data.fnStatement.params[i]->data.identifier.name;
-			object.length =
-			    fn->data.fnStatement.params[i]->data.identifier.length;
-			object.value = args[i];
-			environmentPushObject(functionEnvironment, object);
+		// O pai é o env onde a função foi definida, não o de quem chamou
+		// Só vai para o heap se funções internas podem capturá-lo
+		Environment *parent = AS_FUNCTION_ENVIRONMENT(callee);
+		Environment *functionEnvironment = NULL;
+		if (!fn->hasClosure)
+			functionEnvironment = frameStackPush(
+			    environment->frames, fn->slotCount, parent);
+		else
+			functionEnvironment = environmentCreateCaptured(
+			    fn->slotCount, parent);
+		if (!functionEnvironment)
+			functionEnvironment =
+			    environmentCreate(fn->slotCount, parent);
+		if (!functionEnvironment) {
+			logger(LOG_ERROR, "Internal error: Failed to create environment\n");
+			return evalError();
+		}
+		gcPushObjectRoot(&functionEnvironment->object);
+
+		NodeIndex *params = &tree->lists[fn->params];
+		for (uint32_t i = 0; i < fn->paramCount; i++)
+			define(NODE(params[i]), args[i], functionEnvironment);
+
+		Value result =
+		    evalNode(NODE(fn->statement), arena, functionEnvironment);
+
+		// Envs capturados ficam para o GC
+		if (functionEnvironment->inFrameStack)
+			frameStackPop(environment->frames, functionEnvironment);
+		else if (!fn->hasClosure)
+			environmentDestroy(functionEnvironment);
+		gcRestoreRoots(roots);
+
+		if (completion != COMPLETION_TAIL_CALL) {
+			if (completion == COMPLETION_RETURN)
+				completion = COMPLETION_NORMAL;
+			return result;
 		}
 
-		result =
-		    eval(fn->data.fnStatement.statement, arena, functionEnvironment);
+		// Chamada de cauda: o próximo frame ocupa o lugar deste
+		completion = COMPLETION_NORMAL;
+		root = tailCall.node;
+		callee = tailCall.callee;
+		args = tailCall.args;
+		argc = tailCall.argc;
+		gcPushRoot(callee);
+		for (uint32_t i = 0; i < argc; i++)
+			gcPushRoot(args[i]);
+	}
+}
 
-		environmentDestroy(functionEnvironment);
-	} else if (callee.type == VALUE_FUNCTION_BUILTIN) {
-		result = callee.value.builtin(args, root->data.call.argc, arena, environment);
-	} else {
-		tokenLogger(LOG_ERROR, *root->token,
-		            "Runtime error: Called something that isn't a function");
-		return errorSignal();
+// Call
+Value evalCall(FlatNode *root, Arena *arena, Environment *environment) {
+	ArenaMark mark = arenaMark(arena);
+	size_t roots = gcRootCount();
+
+	Value callee = evalNode(NODE(root->data.call.callee), arena, environment);
+	if (ABRUPT())
+		return callee;
+	gcPushRoot(callee);
+
+	NodeIndex *argNodes = &tree->lists[root->data.call.args];
+	Value *args = arenaAlloc(arena, sizeof(Value) * root->data.call.argc);
+	for (uint32_t i = 0; i < root->data.call.argc; i++) {
+		args[i] = evalNode(NODE(argNodes[i]), arena, environment);
+		if (ABRUPT()) {
+			gcRestoreRoots(roots);
+			arenaRelease(arena, mark);
+			return args[i];
+		}
+		gcPushRoot(args[i]);
 	}
 
-	return returnSignalToValue(result);
+	Value result = evalApply(root, callee, args, root->data.call.argc, arena,
+	                         environment);
+
+	// Args e temporários da chamada morrem aqui
+	gcRestoreRoots(roots);
+	arenaRelease(arena, mark);
+
+	return result;
 }
@@ -4,10 +4,10 @@
  * Licença MIT
  */
 #pragma once
-#include "../parser/ast.h"
+#include "../parser/flat.h"
 #include "arena.h"
 #include "environment.h"
 #include "value.h"
 
-Value eval(AstNode *root, Arena *arena, Environment *environment);
+Value eval(FlatAst *ast, Arena *arena, Environment *environment);
 void printValue(Value value);
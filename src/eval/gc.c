@@ -0,0 +1,353 @@
+/**
+ * gc.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "gc.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../util.h"
+#include "../vm/vm.h"
+#include "environment.h"
+
+// Pode ser reduzido na compilação para testar o GC
+#ifndef GC_INITIAL_THRESHOLD
+#define GC_INITIAL_THRESHOLD (1024 * 1024)
+#endif
+
+// Heap do processo, compartilhado pelo eval e pela VM
+static struct {
+	GcObject *objects;  // Objetos coletáveis
+	GcObject *literals; // Strings literais, liberadas só no gcDestroy
+	uint32_t epoch;
+
+	// Pilha de cinzas da marcação
+	GcObject **gray;
+	size_t grayCount;
+	size_t grayCapacity;
+
+	// Valores em uso pelo código C que ainda não estão em nenhum env
+	GcObject **roots;
+	size_t rootCount;
+	size_t rootCapacity;
+
+	GcRootFunction rootFunction;
+	void *rootData;
+
+	size_t bytesAllocated; // Vivos depois da última coleta + novos
+	size_t threshold;
+
+	// Estatísticas do --gc-stats
+	size_t collections;
+	size_t totalObjects;
+	size_t totalBytes;
+	size_t freedObjects;
+	size_t freedBytes;
+	size_t peakBytes;
+	double seconds;
+} gc = {.epoch = 1, .threshold = GC_INITIAL_THRESHOLD};
+
+// Tamanho de um objeto, para as estatísticas
+static size_t objectSize(GcObject *object) {
+	switch (object->type) {
+	case GC_STRING:
+		return sizeof(String) + ((String *)object)->length;
+	case GC_ENVIRONMENT:
+		return sizeof(Environment) +
+		       ((Environment *)object)->capacity * sizeof(Object);
+	case GC_CLOSURE:
+		return sizeof(Closure) +
+		       ((Closure *)object)->upvalueCount * sizeof(Cell *);
+	case GC_CELL:
+		return sizeof(Cell);
+	case GC_FUNCTION:
+		return sizeof(Function);
+	case GC_BOXED_INTEGER:
+		return sizeof(BoxedInteger);
+	}
+	return 0;
+}
+
+// Aloca um objeto coletável
+void *gcAllocate(GcType type, size_t size) {
+	GcObject *object = (GcObject *)calloc(1, size);
+	if (!object)
+		return NULL;
+
+	object->type = type;
+	object->mark = 0;
+	object->next = gc.objects;
+	gc.objects = object;
+
+	gc.bytesAllocated += size;
+	gc.totalObjects++;
+	gc.totalBytes += size;
+	if (gc.bytesAllocated > gc.peakBytes)
+		gc.peakBytes = gc.bytesAllocated;
+	return object;
+}
+
+// Aloca uma string de runtime, os bytes vêm logo depois dela
+String *gcString(size_t length) {
+	String *string = (String *)gcAllocate(GC_STRING, sizeof(String) + length);
+	if (!string)
+		return NULL;
+
+	string->length = length;
+	string->chars = (const char *)(string + 1);
+	return string;
+}
+
+// Cria a string de um literal, que aponta para o código fonte
+String *gcLiteral(const char *chars, size_t length) {
+	String *string = (String *)calloc(1, sizeof(String));
+	if (!string)
+		return NULL;
+
+	string->object.type = GC_STRING;
+	string->object.next = gc.literals;
+	gc.literals = &string->object;
+	string->length = length;
+	string->chars = chars;
+	return string;
+}
+
+// Cria o inteiro no heap de um literal, que vive até o gcDestroy
+BoxedInteger *gcLiteralInteger(long long value) {
+	BoxedInteger *boxed = (BoxedInteger *)calloc(1, sizeof(BoxedInteger));
+	if (!boxed)
+		return NULL;
+
+	boxed->object.type = GC_BOXED_INTEGER;
+	boxed->object.next = gc.literals;
+	gc.literals = &boxed->object;
+	boxed->value = value;
+	return boxed;
+}
+
+// Define quem marca as raízes do motor de execução
+void gcSetRoots(GcRootFunction function, void *data) {
+	gc.rootFunction = function;
+	gc.rootData = data;
+}
+
+// Empilha uma raiz temporária
+void gcPushObjectRoot(GcObject *object) {
+	if (gc.rootCount >= gc.rootCapacity) {
+		size_t newCapacity = gc.rootCapacity ? gc.rootCapacity * 2 : 256;
+		GcObject **newRoots = (GcObject **)realloc(
+		    gc.roots, newCapacity * sizeof(GcObject *));
+		if (!newRoots) {
+			logger(LOG_ERROR, "Internal error: Failed to grow gc roots\n");
+			exit(1); // Sem a raiz o objeto seria liberado em uso
+		}
+		gc.roots = newRoots;
+		gc.rootCapacity = newCapacity;
+	}
+
+	gc.roots[gc.rootCount++] = object;
+}
+
+// Retorna o objeto de um Value, se tiver
+static GcObject *valueObject(Value value) {
+#ifdef VUL_NANBOX
+	if (NANBOX_IS_DOUBLE(value))
+		return NULL;
+
+	switch (NANBOX_TAG(value)) {
+	case NANBOX_TAG_STRING:
+	case NANBOX_TAG_FUNCTION:
+	case NANBOX_TAG_CLOSURE:
+	case NANBOX_TAG_CELL:
+	case NANBOX_TAG_BOXED_INTEGER:
+		return (GcObject *)NANBOX_POINTER(value);
+	default:
+		return NULL;
+	}
+#else
+	switch (VALUE_TYPE(value)) {
+	case VALUE_STRING:
+		return &AS_STRING(value)->object;
+	case VALUE_FUNCTION_DEFINITION:
+		return AS_FUNCTION_ENVIRONMENT(value)
+		           ? &AS_FUNCTION_ENVIRONMENT(value)->object
+		           : NULL;
+	case VALUE_FUNCTION_CLOSURE:
+		return &AS_CLOSURE(value)->object;
+	case VALUE_CELL:
+		return &AS_CELL(value)->object;
+	default:
+		return NULL;
+	}
+#endif
+}
+
+void gcPushRoot(Value value) { gcPushObjectRoot(valueObject(value)); }
+
+// Número de raízes temporárias, para restaurar depois
+size_t gcRootCount(void) { return gc.rootCount; }
+
+void gcRestoreRoots(size_t count) {
+	if (count < gc.rootCount)
+		gc.rootCount = count;
+}
+
+// Marca um objeto como vivo, os filhos são visitados depois
+void gcMarkObject(GcObject *object) {
+	if (!object || object->mark == gc.epoch)
+		return;
+	object->mark = gc.epoch;
+
+	if (object->type == GC_STRING || object->type == GC_BOXED_INTEGER)
+		return; // Sem filhos
+
+	if (gc.grayCount >= gc.grayCapacity) {
+		size_t newCapacity = gc.grayCapacity ? gc.grayCapacity * 2 : 256;
+		GcObject **newGray =
+		    (GcObject **)realloc(gc.gray, newCapacity * sizeof(GcObject *));
+		if (!newGray) {
+			logger(LOG_ERROR, "Internal error: Failed to grow gc stack\n");
+			exit(1); // Continuar liberaria objetos vivos
+		}
+		gc.gray = newGray;
+		gc.grayCapacity = newCapacity;
+	}
+
+	gc.gray[gc.grayCount++] = object;
+}
+
+void gcMarkValue(Value value) { gcMarkObject(valueObject(value)); }
+
+// Marca os filhos de um objeto
+static void traceObject(GcObject *object) {
+	switch (object->type) {
+	case GC_STRING:
+		break;
+	case GC_ENVIRONMENT: {
+		Environment *environment = (Environment *)object;
+		for (size_t i = 0; i < environment->count; i++)
+			gcMarkValue(environment->objects[i].value);
+		if (environment->parent)
+			gcMarkObject(&environment->parent->object);
+	} break;
+	case GC_CLOSURE: {
+		Closure *closure = (Closure *)object;
+		for (size_t i = 0; i < closure->upvalueCount; i++)
+			gcMarkObject(&closure->upvalues[i]->object);
+	} break;
+	case GC_CELL: {
+		gcMarkValue(((Cell *)object)->value);
+	} break;
+	case GC_FUNCTION: {
+		Environment *environment = ((Function *)object)->environment;
+		if (environment)
+			gcMarkObject(&environment->object);
+	} break;
+	case GC_BOXED_INTEGER:
+		break;
+	}
+}
+
+// Libera um objeto
+static void freeObject(GcObject *object) {
+	if (object->type == GC_ENVIRONMENT) {
+		Environment *environment = (Environment *)object;
+		if (!environment->inlineObjects)
+			free(environment->objects);
+	}
+	free(object);
+}
+
+// Coleta tudo que não é alcançável pelas raízes
+void gcCollect(void) {
+	clock_t start = clock();
+
+	// Um epoch novo desmarca tudo sem percorrer o heap
+	gc.epoch++;
+	if (gc.epoch == 0)
+		gc.epoch = 1;
+
+	// Raízes
+	if (gc.rootFunction)
+		gc.rootFunction(gc.rootData);
+	for (size_t i = 0; i < gc.rootCount; i++)
+		gcMarkObject(gc.roots[i]);
+
+	while (gc.grayCount > 0)
+		traceObject(gc.gray[--gc.grayCount]);
+
+	// Varredura
+	size_t live = 0;
+	GcObject **link = &gc.objects;
+	while (*link) {
+		GcObject *object = *link;
+		size_t size = objectSize(object);
+		if (object->mark == gc.epoch) {
+			live += size;
+			link = &object->next;
+			continue;
+		}
+
+		*link = object->next;
+		gc.freedObjects++;
+		gc.freedBytes += size;
+		freeObject(object);
+	}
+
+	gc.bytesAllocated = live;
+	gc.threshold = live * 2;
+	if (gc.threshold < GC_INITIAL_THRESHOLD)
+		gc.threshold = GC_INITIAL_THRESHOLD;
+
+	gc.collections++;
+	gc.seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Coleta se já alocou o bastante desde a última vez
+// Só pode ser chamado onde todo valor vivo é alcançável pelas raízes
+void gcCheckpoint(void) {
+	if (gc.bytesAllocated >= gc.threshold)
+		gcCollect();
+}
+
+// Imprime as estatísticas do GC
+void gcPrintStats(void) {
+	logger(LOG_INFO,
+	       "GC: %zu collections, %.3f ms\n"
+	       "    allocated %zu objects (%zu bytes)\n"
+	       "    freed %zu objects (%zu bytes)\n"
+	       "    live %zu bytes, peak %zu bytes\n",
+	       gc.collections, gc.seconds * 1000.0, gc.totalObjects,
+	       gc.totalBytes, gc.freedObjects, gc.freedBytes, gc.bytesAllocated,
+	       gc.peakBytes);
+}
+
+// Libera todo o heap
+void gcDestroy(void) {
+	GcObject *object = gc.objects;
+	while (object) {
+		GcObject *next = object->next;
+		freeObject(object);
+		object = next;
+	}
+
+	object = gc.literals;
+	while (object) {
+		GcObject *next = object->next;
+		free(object);
+		object = next;
+	}
+
+	free(gc.gray);
+	free(gc.roots);
+	gc.objects = NULL;
+	gc.literals = NULL;
+	gc.gray = NULL;
+	gc.roots = NULL;
+	gc.grayCount = gc.grayCapacity = 0;
+	gc.rootCount = gc.rootCapacity = 0;
+	gc.bytesAllocated = 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * gc.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "value.h"
+
+// Tipo de objeto do heap
+typedef enum {
+	GC_STRING,
+	GC_ENVIRONMENT,
+	GC_CLOSURE,
+	GC_CELL,
+	GC_FUNCTION,     // Só no VUL_NANBOX
+	GC_BOXED_INTEGER // Só no VUL_NANBOX
+} GcType;
+
+// Cabeçalho de todo objeto que o GC conhece
+typedef struct GcObject {
+	struct GcObject *next;
+	uint32_t mark; // Ciclo em que foi marcado por último
+	GcType type;
+} GcObject;
+
+// String imutável
+// Literais apontam para o código fonte e nunca são coletadas
+typedef struct String {
+	GcObject object;
+	size_t length;
+	const char *chars;
+} String;
+
+// Função do eval com o env onde foi definida
+// No VUL_NANBOX ela não cabe no Value e mora no heap
+typedef struct Function {
+	GcObject object;
+	FlatFunction *definition;
+	Environment *environment;
+} Function;
+
+// Inteiro que não cabe nos 48 bits do VUL_NANBOX
+typedef struct BoxedInteger {
+	GcObject object;
+	long long value;
+} BoxedInteger;
+
+// Marca as raízes de um motor de execução
+typedef void (*GcRootFunction)(void *data);
+
+void *gcAllocate(GcType type, size_t size);
+String *gcString(size_t length);
+String *gcLiteral(const char *chars, size_t length);
+BoxedInteger *gcLiteralInteger(long long value);
+
+void gcSetRoots(GcRootFunction function, void *data);
+void gcPushRoot(Value value);
+void gcPushObjectRoot(GcObject *object);
+size_t gcRootCount(void);
+void gcRestoreRoots(size_t count);
+
+void gcMarkValue(Value value);
+void gcMarkObject(GcObject *object);
+
+void gcCheckpoint(void);
+void gcCollect(void);
+void gcPrintStats(void);
+void gcDestroy(void);
@@ -0,0 +1,366 @@
+/**
+ * operator.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "operator.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../util.h"
+#include "gc.h"
+
+// Reporta um erro de operador
+// Usa o token se tiver, senão só o logger
+static void operatorError(Token token, const char *message) {
+	if (token.array) {
+		tokenLogger(LOG_ERROR, token, "%s", message);
+		return;
+	}
+
+	logger(LOG_ERROR, "%s\n", message);
+}
+
+// Erro de um resultado inteiro que não cabe em 64 bits
+static Value integerOverflow(Token token) {
+	operatorError(token, "Runtime error: Integer overflow");
+	return errorSignal();
+}
+
+// Kernels de operadores que aceitam inteiros e floats
+// makeInt monta o resultado int/int, makeFloat os outros casos
+#define NUMERIC_KERNELS(name, makeInt, makeFloat, op)                          \
+	static Value name##IntInt(Value left, Value right, Token token) {          \
+		(void)token;                                                           \
+		return makeInt(AS_INTEGER(left) op AS_INTEGER(right));                 \
+	}                                                                          \
+	FLOAT_KERNELS(name, makeFloat, op)
+
+// Kernels aritméticos: o int/int usa o builtin, que detecta overflow
+#define ARITHMETIC_KERNELS(name, builtin, op)                                  \
+	static Value name##IntInt(Value left, Value right, Token token) {          \
+		long long result;                                                      \
+		if (builtin(AS_INTEGER(left), AS_INTEGER(right), &result))             \
+			return integerOverflow(token);                                     \
+		return integer(result);                                                \
+	}                                                                          \
+	FLOAT_KERNELS(name, floating, op)
+
+// Kernels com pelo menos um float
+#define FLOAT_KERNELS(name, makeFloat, op)                                     \
+	static Value name##FloatFloat(Value left, Value right, Token token) {      \
+		(void)token;                                                           \
+		return makeFloat(AS_FLOATING(left) op AS_FLOATING(right));             \
+	}                                                                          \
+	static Value name##IntFloat(Value left, Value right, Token token) {        \
+		(void)token;                                                           \
+		return makeFloat((double)AS_INTEGER(left) op AS_FLOATING(right));      \
+	}                                                                          \
+	static Value name##FloatInt(Value left, Value right, Token token) {        \
+		(void)token;                                                           \
+		return makeFloat(AS_FLOATING(left) op (double)AS_INTEGER(right));      \
+	}
+
+// Kernel de operadores que só aceitam inteiros
+#define INTEGER_KERNEL(name, op)                                               \
+	static Value name##IntInt(Value left, Value right, Token token) {          \
+		(void)token;                                                           \
+		return integer(AS_INTEGER(left) op AS_INTEGER(right));                 \
+	}
+
+// Kernel para tipos incompatíveis
+#define ERROR_KERNEL(name, message)                                            \
+	static Value name##Error(Value left, Value right, Token token) {           \
+		(void)left;                                                            \
+		(void)right;                                                           \
+		operatorError(token, "Runtime error: " message);                       \
+		return errorSignal();                                                  \
+	}
+
+ARITHMETIC_KERNELS(add, __builtin_add_overflow, +)
+ARITHMETIC_KERNELS(sub, __builtin_sub_overflow, -)
+ARITHMETIC_KERNELS(mul, __builtin_mul_overflow, *)
+NUMERIC_KERNELS(eq, boolean, boolean, ==)
+NUMERIC_KERNELS(neq, boolean, boolean, !=)
+NUMERIC_KERNELS(lt, boolean, boolean, <)
+NUMERIC_KERNELS(gt, boolean, boolean, >)
+NUMERIC_KERNELS(lte, boolean, boolean, <=)
+NUMERIC_KERNELS(gte, boolean, boolean, >=)
+
+INTEGER_KERNEL(shl, <<)
+INTEGER_KERNEL(shr, >>)
+INTEGER_KERNEL(band, &)
+INTEGER_KERNEL(bor, |)
+INTEGER_KERNEL(bxor, ^)
+
+ERROR_KERNEL(add, "Sum with incompatible types")
+ERROR_KERNEL(sub, "Subtraction with incompatible types")
+ERROR_KERNEL(mul, "Multiplication with incompatible types")
+ERROR_KERNEL(div, "Division with incompatible types")
+ERROR_KERNEL(mod, "Module with incompatible types")
+ERROR_KERNEL(shl, "Shift with incompatible types")
+ERROR_KERNEL(shr, "Shift with incompatible types")
+ERROR_KERNEL(band, "Bitwise and with incompatible types")
+ERROR_KERNEL(bor, "Bitwise or with incompatible types")
+ERROR_KERNEL(bxor, "Bitwise xor with incompatible types")
+ERROR_KERNEL(eq, "Comparison with incompatible types")
+ERROR_KERNEL(neq, "Comparison with incompatible types")
+ERROR_KERNEL(lt, "Comparison with incompatible types")
+ERROR_KERNEL(gt, "Comparison with incompatible types")
+ERROR_KERNEL(lte, "Comparison with incompatible types")
+ERROR_KERNEL(gte, "Comparison with incompatible types")
+
+#undef NUMERIC_KERNELS
+#undef ARITHMETIC_KERNELS
+#undef FLOAT_KERNELS
+#undef INTEGER_KERNEL
+#undef ERROR_KERNEL
+
+// Erro de divisão ou módulo por zero
+static Value divisionByZero(Token token, const char *message) {
+	operatorError(token, message);
+	return errorSignal();
+}
+
+static Value divIntInt(Value left, Value right, Token token) {
+	if (AS_INTEGER(right) == 0)
+		return divisionByZero(token, "Runtime error: Division by zero");
+	if (AS_INTEGER(left) == LLONG_MIN && AS_INTEGER(right) == -1)
+		return integerOverflow(token);
+	return integer(AS_INTEGER(left) / AS_INTEGER(right));
+}
+
+static Value divFloatFloat(Value left, Value right, Token token) {
+	if (AS_FLOATING(right) == 0.0)
+		return divisionByZero(token, "Runtime error: Division by zero");
+	return floating(AS_FLOATING(left) / AS_FLOATING(right));
+}
+
+static Value divIntFloat(Value left, Value right, Token token) {
+	if (AS_FLOATING(right) == 0.0)
+		return divisionByZero(token, "Runtime error: Division by zero");
+	return floating((double)AS_INTEGER(left) / AS_FLOATING(right));
+}
+
+static Value divFloatInt(Value left, Value right, Token token) {
+	if (AS_INTEGER(right) == 0)
+		return divisionByZero(token, "Runtime error: Division by zero");
+	return floating(AS_FLOATING(left) / (double)AS_INTEGER(right));
+}
+
+static Value modIntInt(Value left, Value right, Token token) {
+	if (AS_INTEGER(right) == 0)
+		return divisionByZero(token, "Runtime error: Module by zero");
+	// LLONG_MIN % -1 estoura no C, mas o resto é sempre 0
+	if (AS_INTEGER(right) == -1)
+		return integer(0);
+	return integer(AS_INTEGER(left) % AS_INTEGER(right));
+}
+
+static Value modFloatFloat(Value left, Value right, Token token) {
+	if (AS_FLOATING(right) == 0.0)
+		return divisionByZero(token, "Runtime error: Module by zero");
+	return floating(fmod(AS_FLOATING(left), AS_FLOATING(right)));
+}
+
+static Value modIntFloat(Value left, Value right, Token token) {
+	if (AS_FLOATING(right) == 0.0)
+		return divisionByZero(token, "Runtime error: Module by zero");
+	return floating(fmod((double)AS_INTEGER(left), AS_FLOATING(right)));
+}
+
+static Value modFloatInt(Value left, Value right, Token token) {
+	if (AS_INTEGER(right) == 0)
+		return divisionByZero(token, "Runtime error: Module by zero");
+	return floating(fmod(AS_FLOATING(left), (double)AS_INTEGER(right)));
+}
+
+// Concatena duas strings
+static Value addStringString(Value left, Value right, Token token) {
+	String *l = AS_STRING(left);
+	String *r = AS_STRING(right);
+	String *result = gcString(l->length + r->length);
+	if (!result) {
+		operatorError(token, "Internal error: Failed to alloc string");
+		return errorSignal();
+	}
+	memcpy((char *)result->chars, l->chars, l->length);
+	memcpy((char *)result->chars + l->length, r->chars, r->length);
+	return string(result);
+}
+
+static Value eqStringString(Value left, Value right, Token token) {
+	(void)token;
+	String *l = AS_STRING(left);
+	String *r = AS_STRING(right);
+	return boolean(l->length == r->length &&
+	               memcmp(l->chars, r->chars, l->length) == 0);
+}
+
+static Value neqStringString(Value left, Value right, Token token) {
+	(void)token;
+	String *l = AS_STRING(left);
+	String *r = AS_STRING(right);
+	return boolean(l->length != r->length ||
+	               memcmp(l->chars, r->chars, l->length) != 0);
+}
+
+// and/or aceitam qualquer tipo
+static Value andAny(Value left, Value right, Token token) {
+	(void)token;
+	return boolean(isTrue(left) && isTrue(right));
+}
+
+static Value orAny(Value left, Value right, Token token) {
+	(void)token;
+	return boolean(isTrue(left) || isTrue(right));
+}
+
+// A tabela usa o próprio ValueType como índice das classes
+_Static_assert((int)VALUE_INTEGER == (int)OPERAND_INTEGER &&
+                   (int)VALUE_FLOATING == (int)OPERAND_FLOATING &&
+                   (int)VALUE_STRING == (int)OPERAND_STRING,
+               "ValueType order must match the operand classes");
+
+// Linha de um operador numérico: int/float em qualquer combinação
+#define NUMERIC_ROW(name)                                                      \
+	{                                                                          \
+	    [OPERAND_OTHER] = {name##Error, name##Error, name##Error,              \
+	                       name##Error},                                       \
+	    [OPERAND_INTEGER] = {name##Error, name##IntInt, name##IntFloat,        \
+	                         name##Error},                                     \
+	    [OPERAND_FLOATING] = {name##Error, name##FloatInt, name##FloatFloat,   \
+	                          name##Error},                                    \
+	    [OPERAND_STRING] = {name##Error, name##Error, name##Error,             \
+	                        name##Error},                                      \
+	}
+
+// Linha de um operador só de inteiros
+#define INTEGER_ROW(name)                                                      \
+	{                                                                          \
+	    [OPERAND_OTHER] = {name##Error, name##Error, name##Error,              \
+	                       name##Error},                                       \
+	    [OPERAND_INTEGER] = {name##Error, name##IntInt, name##Error,           \
+	                         name##Error},                                     \
+	    [OPERAND_FLOATING] = {name##Error, name##Error, name##Error,           \
+	                          name##Error},                                    \
+	    [OPERAND_STRING] = {name##Error, name##Error, name##Error,             \
+	                        name##Error},                                      \
+	}
+
+// Linha de um operador numérico que também aceita string/string
+#define STRING_ROW(name)                                                       \
+	{                                                                          \
+	    [OPERAND_OTHER] = {name##Error, name##Error, name##Error,              \
+	                       name##Error},                                       \
+	    [OPERAND_INTEGER] = {name##Error, name##IntInt, name##IntFloat,        \
+	                         name##Error},                                     \
+	    [OPERAND_FLOATING] = {name##Error, name##FloatInt, name##FloatFloat,   \
+	                          name##Error},                                    \
+	    [OPERAND_STRING] = {name##Error, name##Error, name##Error,             \
+	                        name##StringString},                               \
+	}
+
+// Linha de um operador que aceita qualquer tipo
+#define ANY_ROW(name)                                                          \
+	{                                                                          \
+	    [OPERAND_OTHER] = {name##Any, name##Any, name##Any, name##Any},        \
+	    [OPERAND_INTEGER] = {name##Any, name##Any, name##Any, name##Any},      \
+	    [OPERAND_FLOATING] = {name##Any, name##Any, name##Any, name##Any},     \
+	    [OPERAND_STRING] = {name##Any, name##Any, name##Any, name##Any},       \
+	}
+
+// Tabela [operador][classe da esquerda][classe da direita]
+const BinaryKernel
+    operatorKernels[OPERATOR_COUNT][OPERAND_CLASSES][OPERAND_CLASSES] = {
+        [OPERATOR_ADD] = STRING_ROW(add),
+        [OPERATOR_SUB] = NUMERIC_ROW(sub),
+        [OPERATOR_MUL] = NUMERIC_ROW(mul),
+        [OPERATOR_DIV] = NUMERIC_ROW(div),
+        [OPERATOR_MOD] = NUMERIC_ROW(mod),
+        [OPERATOR_SHL] = INTEGER_ROW(shl),
+        [OPERATOR_SHR] = INTEGER_ROW(shr),
+        [OPERATOR_BAND] = INTEGER_ROW(band),
+        [OPERATOR_BOR] = INTEGER_ROW(bor),
+        [OPERATOR_BXOR] = INTEGER_ROW(bxor),
+        [OPERATOR_EQ] = STRING_ROW(eq),
+        [OPERATOR_NEQ] = STRING_ROW(neq),
+        [OPERATOR_LT] = NUMERIC_ROW(lt),
+        [OPERATOR_GT] = NUMERIC_ROW(gt),
+        [OPERATOR_LTE] = NUMERIC_ROW(lte),
+        [OPERATOR_GTE] = NUMERIC_ROW(gte),
+        [OPERATOR_AND] = ANY_ROW(and),
+        [OPERATOR_OR] = ANY_ROW(or),
+};
+
+#undef NUMERIC_ROW
+#undef INTEGER_ROW
+#undef STRING_ROW
+#undef ANY_ROW
+
+// Operador de cada token binário
+static const uint8_t tokenOperators[] = {
+    [TOKEN_PLUS] = OPERATOR_ADD,         [TOKEN_MINUS] = OPERATOR_SUB,
+    [TOKEN_STAR] = OPERATOR_MUL,         [TOKEN_SLASH] = OPERATOR_DIV,
+    [TOKEN_PERCENT] = OPERATOR_MOD,      [TOKEN_SHIFT_LEFT] = OPERATOR_SHL,
+    [TOKEN_SHIFT_RIGHT] = OPERATOR_SHR,  [TOKEN_BIT_AND] = OPERATOR_BAND,
+    [TOKEN_BIT_OR] = OPERATOR_BOR,       [TOKEN_BIT_XOR] = OPERATOR_BXOR,
+    [TOKEN_EQ] = OPERATOR_EQ,            [TOKEN_NEQ] = OPERATOR_NEQ,
+    [TOKEN_LT] = OPERATOR_LT,            [TOKEN_GT] = OPERATOR_GT,
+    [TOKEN_LTE] = OPERATOR_LTE,          [TOKEN_GTE] = OPERATOR_GTE,
+    [TOKEN_AND] = OPERATOR_AND,          [TOKEN_OR] = OPERATOR_OR,
+};
+
+// Aplica um operador binário a partir do token
+// Compartilhado entre o eval e a VM
+Value operatorBinary(TokenType op, Value left, Value right, Token token) {
+	return operatorApply((Operator)tokenOperators[op], left, right, token);
+}
+
+// Aplica um operador unário
+Value operatorUnary(TokenType op, Value operand, Token token) {
+	Value v = null();
+
+	if (op == TOKEN_PLUS) {
+		if (VALUE_TYPE(operand) == VALUE_INTEGER) {
+			v = integer(AS_INTEGER(operand));
+		} else if (VALUE_TYPE(operand) == VALUE_FLOATING) {
+			v = floating(AS_FLOATING(operand));
+		} else {
+			operatorError(
+			    token,
+			    "Runtime error: Unary plus operator with incompatible type\n");
+			return errorSignal();
+		}
+	} else if (op == TOKEN_MINUS) {
+		if (VALUE_TYPE(operand) == VALUE_INTEGER) {
+			if (AS_INTEGER(operand) == LLONG_MIN)
+				return integerOverflow(token);
+			v = integer(-AS_INTEGER(operand));
+		} else if (VALUE_TYPE(operand) == VALUE_FLOATING) {
+			v = floating(-AS_FLOATING(operand));
+		} else {
+			operatorError(
+			    token,
+			    "Runtime error: Unary minus operator with incompatible type\n");
+			return errorSignal();
+		}
+	} else if (op == TOKEN_BIT_NOT) {
+		if (VALUE_TYPE(operand) == VALUE_INTEGER) {
+			v = integer(~AS_INTEGER(operand));
+		} else {
+			operatorError(token,
+			              "Runtime error: Unary bitwise not operator with "
+			              "incompatible type\n");
+			return errorSignal();
+		}
+	} else if (op == TOKEN_NOT) {
+		v = boolean(!isTrue(operand));
+	}
+
+	return v;
+}
@@ -0,0 +1,62 @@
+/**
+ * operator.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include "../lexer/token.h"
+#include "value.h"
+
+// Operadores binários, na mesma ordem dos opcodes OP_ADD..OP_GTE da VM
+// and/or não têm opcode: a VM e o eval fazem curto-circuito antes
+typedef enum {
+	OPERATOR_ADD,
+	OPERATOR_SUB,
+	OPERATOR_MUL,
+	OPERATOR_DIV,
+	OPERATOR_MOD,
+	OPERATOR_SHL,
+	OPERATOR_SHR,
+	OPERATOR_BAND,
+	OPERATOR_BOR,
+	OPERATOR_BXOR,
+	OPERATOR_EQ,
+	OPERATOR_NEQ,
+	OPERATOR_LT,
+	OPERATOR_GT,
+	OPERATOR_LTE,
+	OPERATOR_GTE,
+	OPERATOR_AND,
+	OPERATOR_OR,
+	OPERATOR_COUNT
+} Operator;
+
+// Classes de operando da tabela, o resto dos tipos cai em OPERAND_OTHER
+enum {
+	OPERAND_OTHER = 0,
+	OPERAND_INTEGER,
+	OPERAND_FLOATING,
+	OPERAND_STRING,
+	OPERAND_CLASSES
+};
+
+typedef Value (*BinaryKernel)(Value left, Value right, Token token);
+
+extern const BinaryKernel
+    operatorKernels[OPERATOR_COUNT][OPERAND_CLASSES][OPERAND_CLASSES];
+
+// Classe de um valor na tabela de operadores
+static inline unsigned operatorClass(Value value) {
+	ValueType type = VALUE_TYPE(value);
+	return type <= VALUE_STRING ? (unsigned)type : OPERAND_OTHER;
+}
+
+// Aplica um operador binário pela tabela de kernels
+static inline Value operatorApply(Operator op, Value left, Value right,
+                                  Token token) {
+	return operatorKernels[op][operatorClass(left)][operatorClass(right)](
+	    left, right, token);
+}
+
+Value operatorBinary(TokenType op, Value left, Value right, Token token);
+Value operatorUnary(TokenType op, Value operand, Token token);
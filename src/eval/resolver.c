@@ -0,0 +1,244 @@
+/**
+ * resolver.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "resolver.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "../util.h"
+#include "builtin.h"
+
+// Escopo de uma função (ou o global), os slots são hoisted
+typedef struct Scope {
+	struct Scope *parent;
+	Symbol *symbols;
+	size_t count;
+	size_t capacity;
+	bool global;
+	AstNode *function; // NODE_FN_STATEMENT dono do escopo
+} Scope;
+
+// Procura um nome no escopo
+// Retorna o slot ou -1
+static long scopeFind(Scope *scope, Symbol symbol) {
+	for (size_t i = 0; i < scope->count; i++) {
+		if (scope->symbols[i] == symbol)
+			return (long)i;
+	}
+	return -1;
+}
+
+// Declara um nome no escopo, reaproveitando o slot se já existe
+static bool scopeDeclare(Scope *scope, Symbol symbol) {
+	if (scopeFind(scope, symbol) >= 0)
+		return true;
+
+	if (scope->count >= scope->capacity) {
+		size_t newCapacity = scope->capacity ? scope->capacity * 2 : 8;
+		Symbol *newSymbols = (Symbol *)realloc(
+		    scope->symbols, newCapacity * sizeof(Symbol));
+		if (!newSymbols)
+			return false;
+		scope->symbols = newSymbols;
+		scope->capacity = newCapacity;
+	}
+
+	scope->symbols[scope->count++] = symbol;
+	return true;
+}
+
+static void scopeDestroy(Scope *scope) { free(scope->symbols); }
+
+// Declara as variáveis e funções de um corpo, sem entrar em funções filhas
+static bool hoist(Scope *scope, AstNode *node) {
+	if (!node)
+		return true;
+
+	switch (node->type) {
+	case NODE_PROGRAM: {
+		for (size_t i = 0; i < node->data.program.count; i++) {
+			if (!hoist(scope, node->data.program.statements[i]))
+				return false;
+		}
+	} break;
+	case NODE_BLOCK_STATEMENT: {
+		for (size_t i = 0; i < node->data.blockStatement.count; i++) {
+			if (!hoist(scope, node->data.blockStatement.statements[i]))
+				return false;
+		}
+	} break;
+	case NODE_IF_STATEMENT:
+		return hoist(scope, node->data.ifStatement.thenBranch) &&
+		       hoist(scope, node->data.ifStatement.elseBranch);
+	case NODE_WHILE_STATEMENT:
+		return hoist(scope, node->data.whileStatement.statement);
+	case NODE_FOR_STATEMENT: {
+		// O contador é uma variável da função, como um var
+		AstNode *identifier = node->data.forStatement.identifier;
+		return scopeDeclare(scope, identifier->data.identifier.symbol) &&
+		       hoist(scope, node->data.forStatement.statement);
+	}
+	case NODE_VAR_STATEMENT: {
+		AstNode *identifier = node->data.varStatement.identifier;
+		return scopeDeclare(scope, identifier->data.identifier.symbol);
+	}
+	case NODE_FN_STATEMENT: {
+		AstNode *identifier = node->data.fnStatement.functionName;
+		return scopeDeclare(scope, identifier->data.identifier.symbol);
+	}
+	default:
+		break;
+	}
+
+	return true;
+}
+
+// Calcula o endereço de um identificador
+static void resolveIdentifier(Scope *scope, AstNode *identifier) {
+	int depth = 0;
+	for (Scope *s = scope; s; s = s->parent, depth++) {
+		long slot = scopeFind(s, identifier->data.identifier.symbol);
+		if (slot < 0)
+			continue;
+
+		identifier->data.identifier.depth = s->global ? RESOLVE_GLOBAL : depth;
+		identifier->data.identifier.slot = (size_t)slot;
+		return;
+	}
+
+	// Nunca declarado: fica para o erro em tempo de execução
+	identifier->data.identifier.depth = RESOLVE_DYNAMIC;
+	identifier->data.identifier.slot = 0;
+}
+
+static bool resolveNode(Scope *scope, AstNode *node);
+
+// Resolve o corpo de uma função num escopo novo
+static bool resolveFunction(Scope *parent, AstNode *fn) {
+	Scope scope = {0};
+	scope.parent = parent;
+	scope.function = fn;
+
+	bool ok = true;
+	for (size_t i = 0; ok && i < fn->data.fnStatement.paramCount; i++) {
+		AstNode *param = fn->data.fnStatement.params[i];
+		ok = scopeDeclare(&scope, param->data.identifier.symbol);
+		if (ok)
+			resolveIdentifier(&scope, param);
+	}
+
+	ok = ok && hoist(&scope, fn->data.fnStatement.statement);
+	ok = ok && resolveNode(&scope, fn->data.fnStatement.statement);
+
+	fn->data.fnStatement.slotCount = scope.count;
+	scopeDestroy(&scope);
+	return ok;
+}
+
+// Resolve todos os identificadores de um nó
+static bool resolveNode(Scope *scope, AstNode *node) {
+	if (!node)
+		return true;
+
+	switch (node->type) {
+	case NODE_PROGRAM: {
+		for (size_t i = 0; i < node->data.program.count; i++) {
+			if (!resolveNode(scope, node->data.program.statements[i]))
+				return false;
+		}
+	} break;
+	case NODE_BLOCK_STATEMENT: {
+		for (size_t i = 0; i < node->data.blockStatement.count; i++) {
+			if (!resolveNode(scope, node->data.blockStatement.statements[i]))
+				return false;
+		}
+	} break;
+	case NODE_EXPRESSION_STATEMENT:
+		return resolveNode(scope, node->data.expressionStatement.expression);
+	case NODE_IF_STATEMENT:
+		return resolveNode(scope, node->data.ifStatement.condition) &&
+		       resolveNode(scope, node->data.ifStatement.thenBranch) &&
+		       resolveNode(scope, node->data.ifStatement.elseBranch);
+	case NODE_RETURN_STATEMENT:
+		return resolveNode(scope, node->data.returnStatement.statement);
+	case NODE_WHILE_STATEMENT:
+		return resolveNode(scope, node->data.whileStatement.condition) &&
+		       resolveNode(scope, node->data.whileStatement.statement);
+	case NODE_FOR_STATEMENT: {
+		if (!resolveNode(scope, node->data.forStatement.start) ||
+		    !resolveNode(scope, node->data.forStatement.end))
+			return false;
+		resolveIdentifier(scope, node->data.forStatement.identifier);
+		return resolveNode(scope, node->data.forStatement.statement);
+	}
+	case NODE_VAR_STATEMENT: {
+		if (!resolveNode(scope, node->data.varStatement.expression))
+			return false;
+		resolveIdentifier(scope, node->data.varStatement.identifier);
+	} break;
+	case NODE_FN_STATEMENT: {
+		// O env da função de fora precisa sobreviver à chamada
+		if (scope->function)
+			scope->function->data.fnStatement.hasClosure = true;
+
+		resolveIdentifier(scope, node->data.fnStatement.functionName);
+		return resolveFunction(scope, node);
+	}
+	case NODE_IDENTIFIER: {
+		resolveIdentifier(scope, node);
+	} break;
+	case NODE_BINARYOP:
+	case NODE_LOGICAL:
+		return resolveNode(scope, node->data.binaryOp.left) &&
+		       resolveNode(scope, node->data.binaryOp.right);
+	case NODE_CONDITIONAL:
+		return resolveNode(scope, node->data.conditional.condition) &&
+		       resolveNode(scope, node->data.conditional.thenExpression) &&
+		       resolveNode(scope, node->data.conditional.elseExpression);
+	case NODE_UNARYOP:
+		return resolveNode(scope, node->data.unaryOp.operand);
+	case NODE_ASSIGNMENT:
+		return resolveNode(scope, node->data.assigment.value) &&
+		       resolveNode(scope, node->data.assigment.target);
+	case NODE_CALL: {
+		if (!resolveNode(scope, node->data.call.callee))
+			return false;
+		for (size_t i = 0; i < node->data.call.argc; i++) {
+			if (!resolveNode(scope, node->data.call.args[i]))
+				return false;
+		}
+	} break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+// Resolve os identificadores do programa para endereços (depth, slot)
+// As builtins ocupam os primeiros slots globais
+bool resolverResolve(AstNode *root) {
+	if (!root || root->type != NODE_PROGRAM)
+		return false;
+
+	Scope global = {0};
+	global.global = true;
+
+	bool ok = true;
+	for (size_t i = 0; ok && builtins[i].name; i++)
+		ok = scopeDeclare(&global,
+		                  symbolIntern(builtins[i].name, builtins[i].length));
+
+	ok = ok && hoist(&global, root);
+	ok = ok && resolveNode(&global, root);
+	if (!ok)
+		logger(LOG_ERROR, "Internal error: Failed to resolve names\n");
+
+	root->data.program.slotCount = global.count;
+	scopeDestroy(&global);
+	return ok;
+}
@@ -0,0 +1,11 @@
+/**
+ * resolver.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stdbool.h>
+
+#include "../parser/ast.h"
+
+bool resolverResolve(AstNode *root);
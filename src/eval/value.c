@@ -5,70 +5,31 @@
  */
 #include "value.h"
 #include "../util.h"
+#include "gc.h"
+#include <math.h>
 #include <stddef.h>
 #include <stdio.h>
-#include <stdlib.h>
-
-// Parsea escapes
-char *parseEscapes(const char *start, size_t length, size_t *outLength) {
-	char *buffer = malloc(length + 1); // no máximo o tamanho original
-	if (!buffer)
-		return NULL;
-
-	size_t j = 0;
-	for (size_t i = 0; i < length; i++) {
-		if (start[i] == '\\' && i + 1 < length) {
-			i++;
-			switch (start[i]) {
-			case 'n':
-				buffer[j++] = '\n';
-				break;
-			case 't':
-				buffer[j++] = '\t';
-				break;
-			case 'r':
-				buffer[j++] = '\r';
-				break;
-			case '\\':
-				buffer[j++] = '\\';
-				break;
-			case '"':
-				buffer[j++] = '"';
-				break;
-			default:
-				buffer[j++] = start[i];
-				break; // escapa qualquer outro
-			}
-		} else {
-			buffer[j++] = start[i];
-		}
-	}
-
-	*outLength = j;
-	buffer[j] = '\0';
-	return buffer;
-}
 
 // Imprime um "value"
 void valuePrint(Value value) {
-	switch (value.type) {
+	switch (VALUE_TYPE(value)) {
 	case VALUE_INTEGER:
-		printf("%lld\n", value.value.integer);
-		break;
-	case VALUE_FLOATING:
-		printf("%.6lf\n", value.value.floating);
+		printf("%lld\n", AS_INTEGER(value));
 		break;
+	case VALUE_FLOATING: {
+		// O sinal de um NaN depende do layout do Value, não do programa
+		double number = AS_FLOATING(value);
+		if (isnan(number))
+			printf("nan\n");
+		else
+			printf("%.6lf\n", number);
+	} break;
 	case VALUE_STRING:
-		size_t len;
-		char *parsed = parseEscapes(value.value.string.start,
-		                            value.value.string.length, &len);
-		if (parsed) {
-			printf("%.*s", (int)len, parsed);
-			free(parsed);
-		}
+		// Os escapes já foram decodificados pelo parser
+		fwrite(AS_STRING(value)->chars, 1, AS_STRING(value)->length, stdout);
 		break;
 	case VALUE_BOOLEAN:
-		printf("%s\n", value.value.boolean ? "true" : "false");
+		printf("%s\n", AS_BOOLEAN(value) ? "true" : "false");
 		break;
 	case VALUE_NULL:
 		printf("null\n");
@@ -81,6 +42,7 @@ void valuePrint(Value value) {
 	}
 }
 
+#ifndef VUL_NANBOX
 // Retorna um Value integer
 Value integer(long long value) {
 	Value v;
@@ -98,11 +60,10 @@ Value floating(double value) {
 }
 
 // Retorna um Value string
-Value string(const char *start, size_t len) {
+Value string(String *s) {
 	Value v;
 	v.type = VALUE_STRING;
-	v.value.string.start = start;
-	v.value.string.length = len;
+	v.value.string = s;
 	return v;
 }
 
@@ -122,21 +83,42 @@ Value null(void) {
 }
 
 // Retorna um Value de function definition
-Value function(AstNode *f) {
+Value function(FlatFunction *f, Environment *environment) {
 	Value v;
 	v.type = VALUE_FUNCTION_DEFINITION;
-	v.value.function = f;
+	v.value.function.definition = f;
+	v.value.function.environment = environment;
 	return v;
 }
 
-// Retorna um Value return signal
-Value returnSignal(Value value, Arena *arena) {
-	Value *ret = arenaAlloc(arena, sizeof(Value));
-	*ret = value;
+// Retorna um Value de built-in
+Value builtinValue(BuiltinFunction builtin) {
+	Value v;
+	v.type = VALUE_FUNCTION_BUILTIN;
+	v.value.builtin = builtin;
+	return v;
+}
+
+// Retorna um Value de closure da VM
+Value closureValue(struct Closure *closure) {
+	Value v;
+	v.type = VALUE_FUNCTION_CLOSURE;
+	v.value.closure = closure;
+	return v;
+}
+
+// Retorna um Value de cell da VM
+Value cellValue(struct Cell *cell) {
+	Value v;
+	v.type = VALUE_CELL;
+	v.value.cell = cell;
+	return v;
+}
 
+// Retorna um Value ainda não definido
+Value undefined(void) {
 	Value v;
-	v.type = VALUE_RETURN_SIGNAL;
-	v.value.returnValue = ret;
+	v.type = VALUE_UNDEFINED;
 	return v;
 }
 
@@ -146,36 +128,133 @@ Value errorSignal(void) {
 	v.type = VALUE_ERROR_SIGNAL;
 	return v;
 }
+#else
+// Retorna um Value integer
+// Fora dos 48 bits vai para o heap
+Value integer(long long value) {
+	if (value >= NANBOX_MIN_INTEGER && value <= NANBOX_MAX_INTEGER)
+		return NANBOX_MAKE(NANBOX_TAG_INTEGER, (uint64_t)value);
+
+	BoxedInteger *boxed =
+	    (BoxedInteger *)gcAllocate(GC_BOXED_INTEGER, sizeof(BoxedInteger));
+	if (!boxed) {
+		logger(LOG_ERROR, "Internal error: Failed to alloc integer\n");
+		return errorSignal();
+	}
+	boxed->value = value;
+	return NANBOX_MAKE(NANBOX_TAG_BOXED_INTEGER, (uintptr_t)boxed);
+}
+
+// Retorna o Value de um literal inteiro
+// Fora dos 48 bits vai para os literais do GC, criado uma vez só
+Value integerLiteral(long long value) {
+	if (value >= NANBOX_MIN_INTEGER && value <= NANBOX_MAX_INTEGER)
+		return NANBOX_MAKE(NANBOX_TAG_INTEGER, (uint64_t)value);
 
-// Retorna o Value de retorno de um returnSignal
-Value returnSignalToValue(Value v) {
-	if (v.type == VALUE_RETURN_SIGNAL) {
-		return *v.value.returnValue;
+	BoxedInteger *boxed = gcLiteralInteger(value);
+	if (!boxed) {
+		logger(LOG_ERROR, "Internal error: Failed to alloc integer\n");
+		return errorSignal();
 	}
+	return NANBOX_MAKE(NANBOX_TAG_BOXED_INTEGER, (uintptr_t)boxed);
+}
+
+// Valor de um inteiro no heap
+long long valueBoxedInteger(Value v) {
+	return ((BoxedInteger *)NANBOX_POINTER(v))->value;
+}
+
+// Retorna um Value float(double)
+// NaNs viram o NaN canônico para não parecerem uma tag
+Value floating(double value) {
+	if (value != value)
+		return NANBOX_CANONICAL_NAN;
+
+	Value v;
+	memcpy(&v, &value, sizeof(double));
 	return v;
 }
 
+// Retorna um Value string
+Value string(String *s) { return NANBOX_MAKE(NANBOX_TAG_STRING, (uintptr_t)s); }
+
+// Retorna um Value boolean
+Value boolean(bool value) {
+	return NANBOX_MAKE(NANBOX_TAG_SPECIAL,
+	                   value ? NANBOX_SPECIAL_TRUE : NANBOX_SPECIAL_FALSE);
+}
+
+// Retorna um Value null
+Value null(void) { return NANBOX_MAKE(NANBOX_TAG_SPECIAL, NANBOX_SPECIAL_NULL); }
+
+// Retorna um Value de function definition
+// Definição + env não cabem em 48 bits, a função vai para o heap
+Value function(FlatFunction *f, Environment *environment) {
+	Function *fn = (Function *)gcAllocate(GC_FUNCTION, sizeof(Function));
+	if (!fn) {
+		logger(LOG_ERROR, "Internal error: Failed to alloc function\n");
+		return errorSignal();
+	}
+	fn->definition = f;
+	fn->environment = environment;
+	return NANBOX_MAKE(NANBOX_TAG_FUNCTION, (uintptr_t)fn);
+}
+
+FlatFunction *valueFunctionDefinition(Value v) {
+	return ((Function *)NANBOX_POINTER(v))->definition;
+}
+
+Environment *valueFunctionEnvironment(Value v) {
+	return ((Function *)NANBOX_POINTER(v))->environment;
+}
+
+// Retorna um Value de built-in
+Value builtinValue(BuiltinFunction builtin) {
+	return NANBOX_MAKE(NANBOX_TAG_BUILTIN, (uintptr_t)builtin);
+}
+
+// Retorna um Value de closure da VM
+Value closureValue(struct Closure *closure) {
+	return NANBOX_MAKE(NANBOX_TAG_CLOSURE, (uintptr_t)closure);
+}
+
+// Retorna um Value de cell da VM
+Value cellValue(struct Cell *cell) {
+	return NANBOX_MAKE(NANBOX_TAG_CELL, (uintptr_t)cell);
+}
+
+// Retorna um Value ainda não definido
+Value undefined(void) {
+	return NANBOX_MAKE(NANBOX_TAG_SPECIAL, NANBOX_SPECIAL_UNDEFINED);
+}
+
+// Retorna um Value error signal
+Value errorSignal(void) {
+	return NANBOX_MAKE(NANBOX_TAG_SPECIAL, NANBOX_SPECIAL_ERROR);
+}
+#endif
+
 // Retorna true se um Value for verdadeiro
 bool isTrue(Value value) {
-	switch (value.type) {
+	switch (VALUE_TYPE(value)) {
 	case VALUE_INTEGER: {
-		return value.value.integer != 0;
+		return AS_INTEGER(value) != 0;
 	} break;
 	case VALUE_FLOATING: {
-		return value.value.floating != 0.0f;
+		return AS_FLOATING(value) != 0.0f;
 	} break;
 	case VALUE_STRING: {
-		return value.value.string.length > 0;
+		return AS_STRING(value)->length > 0;
 	} break;
 	case VALUE_BOOLEAN: {
-		return value.value.boolean;
+		return AS_BOOLEAN(value);
 	} break;
 	case VALUE_NULL: {
 		return false;
 	} break;
 	default: {
 		logger(LOG_ERROR, "Internal error: Control signal or special value passed to %s(%d)\n",
-				       __func__, value.type);
+				       __func__, VALUE_TYPE(value));
 				return false;
 	} break;
 	}
@@ -4,16 +4,24 @@
  * Licença MIT
  */
 #pragma once
-#include "../parser/ast.h"
+#include "../parser/flat.h"
 #include "arena.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 typedef struct Environment Environment;
+struct String;
+struct Closure;
+struct Cell;
 
 typedef enum {
+	// Interno: variável ainda não definida
+	VALUE_UNDEFINED = 0,
+
 	// Literais
-	VALUE_INTEGER = 1,
+	VALUE_INTEGER,
 	VALUE_FLOATING,
 	VALUE_STRING,
 	VALUE_BOOLEAN,
@@ -22,36 +30,158 @@ typedef enum {
 	// Especiais
 	VALUE_FUNCTION_DEFINITION,
 	VALUE_FUNCTION_BUILTIN,
+	VALUE_FUNCTION_CLOSURE, // Função da VM
+	VALUE_CELL,             // Interno da VM: variável capturada
 
 	// Sinais
-	VALUE_RETURN_SIGNAL,
 	VALUE_ERROR_SIGNAL
 } ValueType;
 
-typedef struct Value {
+#ifndef VUL_NANBOX
+typedef struct Value Value;
+#else
+typedef uint64_t Value;
+#endif
+
+typedef Value (*BuiltinFunction)(Value *args, size_t argc, Arena *arena,
+                                 Environment *environment);
+
+#ifndef VUL_NANBOX
+// Value como tagged union
+struct Value {
 	ValueType type;
 	union {
 		long long integer;
 		double floating;
-		struct {
-			const char *start;
-			size_t length;
-		} string;
+		struct String *string;
 		bool boolean;
-		struct Value *returnValue;
-		AstNode *function;
-		struct Value (*builtin)(struct Value *, size_t, Arena *, Environment *);
+		struct {
+			FlatFunction *definition;
+			Environment *environment; // Onde a função foi definida
+		} function;
+		BuiltinFunction builtin;
+		struct Closure *closure;
+		struct Cell *cell;
 	} value;
-} Value;
+};
+
+#define VALUE_TYPE(v) ((v).type)
+#define AS_INTEGER(v) ((v).value.integer)
+#define AS_FLOATING(v) ((v).value.floating)
+#define AS_BOOLEAN(v) ((v).value.boolean)
+#define AS_STRING(v) ((v).value.string)
+#define AS_FUNCTION_DEFINITION(v) ((v).value.function.definition)
+#define AS_FUNCTION_ENVIRONMENT(v) ((v).value.function.environment)
+#define AS_BUILTIN(v) ((v).value.builtin)
+#define AS_CLOSURE(v) ((v).value.closure)
+#define AS_CELL(v) ((v).value.cell)
+#define VALUE_IS_ERROR(v) ((v).type == VALUE_ERROR_SIGNAL)
+#else
+// Value NaN-boxed: um double normal ou um NaN quieto com tag e payload
+// Tag nos 16 bits de cima, payload (inteiro ou ponteiro) nos 48 de baixo
+#define NANBOX_CANONICAL_NAN 0x7FF8000000000000ULL
+#define NANBOX_PAYLOAD_MASK 0x0000FFFFFFFFFFFFULL
+
+#define NANBOX_TAG_INTEGER 0x7FF9
+#define NANBOX_TAG_SPECIAL 0x7FFA // undefined, null, booleanos e erro
+#define NANBOX_TAG_STRING 0x7FFB
+#define NANBOX_TAG_FUNCTION 0x7FFC
+#define NANBOX_TAG_BUILTIN 0x7FFD
+#define NANBOX_TAG_CLOSURE 0x7FFE
+#define NANBOX_TAG_CELL 0x7FFF
+#define NANBOX_TAG_BOXED_INTEGER 0xFFF9 // Não cabe em 48 bits, mora no heap
+
+#define NANBOX_SPECIAL_UNDEFINED 0
+#define NANBOX_SPECIAL_NULL 1
+#define NANBOX_SPECIAL_FALSE 2
+#define NANBOX_SPECIAL_TRUE 3
+#define NANBOX_SPECIAL_ERROR 4
+
+#define NANBOX_MAKE(tag, payload)                                              \
+	(((uint64_t)(tag) << 48) | ((uint64_t)(payload) & NANBOX_PAYLOAD_MASK))
+#define NANBOX_TAG(v) ((uint16_t)((v) >> 48))
+#define NANBOX_PAYLOAD(v) ((v) & NANBOX_PAYLOAD_MASK)
+#define NANBOX_POINTER(v) ((void *)(uintptr_t)NANBOX_PAYLOAD(v))
+#define NANBOX_IS_DOUBLE(v)                                                    \
+	((NANBOX_TAG(v) & 0x7FF8) != 0x7FF8 || (v) == NANBOX_CANONICAL_NAN)
+
+#define NANBOX_MIN_INTEGER (-(1LL << 47))
+#define NANBOX_MAX_INTEGER ((1LL << 47) - 1)
+
+Value integerLiteral(long long value);
+long long valueBoxedInteger(Value v);
+FlatFunction *valueFunctionDefinition(Value v);
+Environment *valueFunctionEnvironment(Value v);
+
+// Tipo de um Value NaN-boxed
+static inline ValueType valueType(Value v) {
+	if (NANBOX_IS_DOUBLE(v))
+		return VALUE_FLOATING;
+
+	switch (NANBOX_TAG(v)) {
+	case NANBOX_TAG_INTEGER:
+	case NANBOX_TAG_BOXED_INTEGER:
+		return VALUE_INTEGER;
+	case NANBOX_TAG_STRING:
+		return VALUE_STRING;
+	case NANBOX_TAG_FUNCTION:
+		return VALUE_FUNCTION_DEFINITION;
+	case NANBOX_TAG_BUILTIN:
+		return VALUE_FUNCTION_BUILTIN;
+	case NANBOX_TAG_CLOSURE:
+		return VALUE_FUNCTION_CLOSURE;
+	case NANBOX_TAG_CELL:
+		return VALUE_CELL;
+	}
+
+	switch (NANBOX_PAYLOAD(v)) {
+	case NANBOX_SPECIAL_NULL:
+		return VALUE_NULL;
+	case NANBOX_SPECIAL_FALSE:
+	case NANBOX_SPECIAL_TRUE:
+		return VALUE_BOOLEAN;
+	case NANBOX_SPECIAL_ERROR:
+		return VALUE_ERROR_SIGNAL;
+	default:
+		return VALUE_UNDEFINED;
+	}
+}
+
+// Double de um Value NaN-boxed
+static inline double valueFloating(Value v) {
+	double d;
+	memcpy(&d, &v, sizeof(double));
+	return d;
+}
+
+#define VALUE_TYPE(v) valueType(v)
+#define AS_INTEGER(v)                                                          \
+	(NANBOX_TAG(v) == NANBOX_TAG_INTEGER                                       \
+	     ? (long long)((int64_t)((v) << 16) >> 16)                             \
+	     : valueBoxedInteger(v))
+#define AS_FLOATING(v) valueFloating(v)
+#define AS_BOOLEAN(v)                                                          \
+	((v) == NANBOX_MAKE(NANBOX_TAG_SPECIAL, NANBOX_SPECIAL_TRUE))
+#define AS_STRING(v) ((struct String *)NANBOX_POINTER(v))
+#define AS_FUNCTION_DEFINITION(v) valueFunctionDefinition(v)
+#define AS_FUNCTION_ENVIRONMENT(v) valueFunctionEnvironment(v)
+#define AS_BUILTIN(v) ((BuiltinFunction)NANBOX_POINTER(v))
+#define AS_CLOSURE(v) ((struct Closure *)NANBOX_POINTER(v))
+#define AS_CELL(v) ((struct Cell *)NANBOX_POINTER(v))
+#define VALUE_IS_ERROR(v)                                                      \
+	((v) == NANBOX_MAKE(NANBOX_TAG_SPECIAL, NANBOX_SPECIAL_ERROR))
+#endif
 
 void valuePrint(Value value);
 Value integer(long long value);
 Value floating(double value);
-Value string(const char *start, size_t len);
+Value string(struct String *s);
 Value boolean(bool value);
 Value null(void);
-Value function(AstNode *f);
-Value returnSignal(Value value, Arena *arena);
+Value function(FlatFunction *f, Environment *environment);
+Value builtinValue(BuiltinFunction builtin);
+Value closureValue(struct Closure *closure);
+Value cellValue(struct Cell *cell);
+Value undefined(void);
 Value errorSignal(void);
-Value returnSignalToValue(Value v);
 bool isTrue(Value value);
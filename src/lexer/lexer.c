@@ -8,40 +8,88 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "number.h"
+#include "scan.h"
 #include "token.h"
 #include "util.h"
 
-typedef struct {
-	const char *name;
-	TokenType type;
-} Keyword;
-
-Keyword keywords[] = {
-    {"int", TOKEN_KEYWORD_INT},
-    {"boolean", TOKEN_KEYWORD_BOOLEAN},
-    {"string", TOKEN_KEYWORD_STRING},
-
-    {"true", TOKEN_KEYWORD_TRUE},
-    {"false", TOKEN_KEYWORD_FALSE},
-    {"null", TOKEN_KEYWORD_NULL},
-
-    {"if", TOKEN_KEYWORD_IF},
-    {"else", TOKEN_KEYWORD_ELSE},
-    {"while", TOKEN_KEYWORD_WHILE},
-
-    {"var", TOKEN_KEYWORD_VAR},
-    {"fn", TOKEN_KEYWORD_FN},
-    {"return", TOKEN_KEYWORD_RETURN},
+// Confere o resto de um identificador contra uma keyword
+// O tamanho e o primeiro caractere já bateram
+static TokenType matchKeyword(const char *start, const char *word,
+                              size_t length, TokenType type) {
+	if (memcmp(start + 1, word + 1, length - 1) == 0)
+		return type;
+	return TOKEN_IDENTIFIER;
+}
 
-    {"and", TOKEN_AND},
-    {"or", TOKEN_OR},
-    {"not", TOKEN_NOT},
+// Classifica um identificador como keyword pelo tamanho e primeiro caractere
+// No máximo um memcmp por identificador
+static TokenType keywordType(const char *start, size_t length) {
+	switch (length) {
+	case 2:
+		switch (start[0]) {
+		case 'i':
+			if (start[1] == 'n')
+				return TOKEN_KEYWORD_IN;
+			return matchKeyword(start, "if", 2, TOKEN_KEYWORD_IF);
+		case 'f':
+			return matchKeyword(start, "fn", 2, TOKEN_KEYWORD_FN);
+		case 'o':
+			return matchKeyword(start, "or", 2, TOKEN_OR);
+		}
+		break;
+	case 3:
+		switch (start[0]) {
+		case 'i':
+			return matchKeyword(start, "int", 3, TOKEN_KEYWORD_INT);
+		case 'f':
+			return matchKeyword(start, "for", 3, TOKEN_KEYWORD_FOR);
+		case 'v':
+			return matchKeyword(start, "var", 3, TOKEN_KEYWORD_VAR);
+		case 'a':
+			return matchKeyword(start, "and", 3, TOKEN_AND);
+		case 'n':
+			return matchKeyword(start, "not", 3, TOKEN_NOT);
+		}
+		break;
+	case 4:
+		switch (start[0]) {
+		case 't':
+			return matchKeyword(start, "true", 4, TOKEN_KEYWORD_TRUE);
+		case 'n':
+			return matchKeyword(start, "null", 4, TOKEN_KEYWORD_NULL);
+		case 'e':
+			return matchKeyword(start, "else", 4, TOKEN_KEYWORD_ELSE);
+		}
+		break;
+	case 5:
+		switch (start[0]) {
+		case 'f':
+			return matchKeyword(start, "false", 5, TOKEN_KEYWORD_FALSE);
+		case 'w':
+			return matchKeyword(start, "while", 5, TOKEN_KEYWORD_WHILE);
+		}
+		break;
+	case 6:
+		switch (start[0]) {
+		case 's':
+			return matchKeyword(start, "string", 6, TOKEN_KEYWORD_STRING);
+		case 'r':
+			return matchKeyword(start, "return", 6, TOKEN_KEYWORD_RETURN);
+		}
+		break;
+	case 7:
+		if (start[0] == 'b')
+			return matchKeyword(start, "boolean", 7, TOKEN_KEYWORD_BOOLEAN);
+		break;
+	}
 
-    {NULL, 0} // Para aqui
-};
+	return TOKEN_IDENTIFIER;
+}
 
 // Valída um lexer
 bool lexerValidate(Lexer *l) {
@@ -64,27 +112,28 @@ bool lexerValidate(Lexer *l) {
 }
 
 // Retorna true se esta no fim do conteúdo
-static bool eof(Lexer *l) {
-	if (!lexerValidate(l))
-		return true;
-
-	return l->pos >= l->contentSize;
+// O lexer já foi validado no lexerTokenize
+static bool eof(Lexer *l) { return l->pos >= l->contentSize; }
+
+// Bytes que faltam a partir de pos
+static size_t remaining(Lexer *l) { return l->contentSize - l->pos; }
+
+// Avança length bytes, guardando o início de cada linha nova no trecho
+static void skip(Lexer *l, TokenArray *tokens, size_t length) {
+	size_t end = l->pos + length;
+	for (;;) {
+		size_t newline = scanFind(&l->content[l->pos], end - l->pos, '\n');
+		if (l->pos + newline >= end)
+			break;
+		l->pos += newline + 1;
+		tokenPushLine(tokens, l->pos);
+	}
+	l->pos = end;
 }
 
 // Pula enquanto não tem um caractere
-static void skipUntil(Lexer *l, char c) {
-	if (!lexerValidate(l))
-		return;
-
-	while (!eof(l) && l->content[l->pos] != c) {
-		if (l->content[l->pos] == '\n') {
-			l->line++;
-			l->column = 1;
-		} else {
-			l->column++;
-		}
-		l->pos++;
-	}
+static void skipUntil(Lexer *l, TokenArray *tokens, char c) {
+	skip(l, tokens, scanFind(&l->content[l->pos], remaining(l), c));
 }
 
 // Retorna o caracere atual do content do lexer
@@ -121,6 +170,12 @@ Lexer *lexerCreate(const char *content, size_t contentSize) {
 		return NULL;
 	}
 
+	// Tokens guardam offsets de 32 bits
+	if (contentSize > UINT32_MAX) {
+		logger(LOG_ERROR, "Lexer error: Content is larger than 4GiB\n");
+		return NULL;
+	}
+
 	Lexer *l = (Lexer *)malloc(sizeof(Lexer));
 	if (!l)
 		return NULL;
@@ -128,9 +183,8 @@ Lexer *lexerCreate(const char *content, size_t contentSize) {
 	l->content = content;
 	l->contentSize = contentSize;
 	l->pos = 0;
-	l->line = 1;
-	l->column = 1;
 
+	scanInit();
 	return l;
 }
 
@@ -140,37 +194,32 @@ TokenArray lexerTokenize(Lexer *l) {
 	TokenArray tokens = {0};
 	if (!lexerValidate(l))
 		return tokens;
-	tokenInit(&tokens);
+	tokenInit(&tokens, l->content, l->contentSize);
 
-	// Parte 1: tudo menos keywords
 	while (!eof(l)) {
 		char c = peek(l);
 
-		// Quebra de linha
-		if (c == '\n') {
-			l->line++;
-			l->column = 1;
+		// Espaço simples entre tokens, o caso mais comum
+		if (c == ' ' && next(l) > ' ') {
 			l->pos++;
 			continue;
 		}
 
-		// Pular espaço, tab e carriage return
-		if (c == ' ' || c == '\t' || c == '\r') {
-			l->column++;
-			l->pos++;
+		// Espaços, tabs e quebras de linha
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			skip(l, &tokens, scanWhitespace(&l->content[l->pos], remaining(l)));
 			continue;
 		}
 
 		// Comentarios
 		if (c == '#') {
 			l->pos++; // Pular #
-			skipUntil(l, '\n');
+			l->pos += scanFind(&l->content[l->pos], remaining(l), '\n');
 
-			// Aqui só pode ser \n ou \0
-			if (l->content[l->pos] == '\n') {
-				l->line++;
-				l->column = 1;
+			// Aqui só pode ser \n ou o fim
+			if (!eof(l)) {
 				l->pos++;
+				tokenPushLine(&tokens, l->pos);
 			} else {
 				break;
 			}
@@ -178,76 +227,37 @@ TokenArray lexerTokenize(Lexer *l) {
 		}
 
 		// Números
+		// O valor sai junto com o tamanho, o parser não relê o texto
 		if (isdigit(c)) {
-			// Usar strtol para descobrir o final do número
-			const char *start = &l->content[l->pos];
-			char *integerEnd;
-
-			strtoll(start, &integerEnd, 0);
-
-			// Verificar se é inteiro
-			if (integerEnd != start && *integerEnd != '.') {
-				Token t;
-				t.type = TOKEN_NUMBER_INTEGER;
-				t.content = l->content;
-				t.start = start;
-				t.length = (size_t)(integerEnd - start);
-				t.line = l->line;
-				t.column = l->column;
-				tokenPush(&tokens, t);
-
-				l->pos += t.length;
-				l->column += t.length;
-				continue;
-			}
-			// Se chegou aqui provavelmente é float/double
-			char *floatingEnd;
-
-			strtod(start, &floatingEnd);
-
-			if (floatingEnd != start) {
-				Token t;
-				t.type = TOKEN_NUMBER_FLOAT;
-				t.content = l->content;
-				t.start = start;
-				t.length = (size_t)(floatingEnd - start);
-				t.line = l->line;
-				t.column = l->column;
-				tokenPush(&tokens, t);
-
-				l->pos += t.length;
-				l->column += t.length;
-				continue;
-			}
+			TokenNumber number;
+			bool isFloat;
+			size_t length = numberParse(&l->content[l->pos], remaining(l),
+			                            &number, &isFloat);
+			tokenPushNumber(&tokens,
+			                isFloat ? TOKEN_NUMBER_FLOAT : TOKEN_NUMBER_INTEGER,
+			                l->pos, length, number);
+
+			l->pos += length;
+			continue;
 		}
 
 		// Strings
 		if (c == '"' || c == '\'') {
-			size_t startColumn = l->column;
 			l->pos++;
-			l->column++;
-			const char *start = &l->content[l->pos];
-
-			skipUntil(l, c);
+			size_t start = l->pos;
 
-			// Aqui só pode ser '|" ou \0
-			if (l->content[l->pos] == c) {
-				const char *end = &l->content[l->pos];
+			skipUntil(l, &tokens, c);
 
-				Token t;
-				t.type = TOKEN_STRING;
-				t.content = l->content;
-				t.start = start;
-				t.length = (size_t)(end - start);
-				t.line = l->line;
-				t.column = startColumn;
-				tokenPush(&tokens, t);
+			// Aqui só pode ser '|" ou o fim
+			if (!eof(l)) {
+				tokenPush(&tokens, TOKEN_STRING, start, l->pos - start);
 
 				l->pos++;
-				l->column++;
 			} else {
-				logger(LOG_ERROR, "Unterminated string at %zu:%zu\n", l->line,
-				       l->column);
+				size_t line, column;
+				tokenLocate(&tokens, l->pos, &line, &column);
+				logger(LOG_ERROR, "Unterminated string at %zu:%zu\n", line,
+				       column);
 				break;
 			}
 			continue;
@@ -255,225 +265,195 @@ TokenArray lexerTokenize(Lexer *l) {
 
 		// Identificadores
 		if (isalpha(c) || c == '_') {
-			size_t startColumn = l->column;
-			const char *start = &l->content[l->pos];
+			size_t start = l->pos;
 			l->pos++; // Pular char
-			l->column++;
 
-			// Incrementar pos e column enquanto caractere for
-			// isalnum ou _
-			while (isalnum(peek(l)) || peek(l) == '_') {
-				l->pos++;
-				l->column++;
-			}
-			const char *end = &l->content[l->pos];
-
-			// Aqui só pode ser não alfanumérico|_ ou \0
-			if (!isalnum(peek(l)) && peek(l) != '_') {
-				Token t;
-				t.type = TOKEN_IDENTIFIER;
-				t.content = l->content;
-				t.start = start;
-				t.length = (size_t)(end - start);
-				t.line = l->line;
-				t.column = startColumn;
-				tokenPush(&tokens, t);
-			} else {
-				break;
-			}
+			// Letras, dígitos e _ até o fim do identificador
+			size_t length = scanIdentifier(&l->content[l->pos], remaining(l));
+			l->pos += length;
+
+			// Identificadores entram na tabela de símbolos aqui
+			length = l->pos - start;
+			const char *name = &l->content[start];
+			TokenType type = keywordType(name, length);
+			if (type == TOKEN_IDENTIFIER)
+				tokenPushSymbol(&tokens, start, length,
+				                symbolIntern(name, length));
+			else
+				tokenPush(&tokens, type, start, length);
 			continue;
 		}
 
 		// Operadores e simbolos
-		Token t;
-		t.content = l->content;
-		t.start = &l->content[l->pos];
-		t.length = 1;
-		t.line = l->line;
-		t.column = l->column;
+		TokenType type;
+		size_t start = l->pos;
+		size_t length = 1;
 
 		switch (c) {
 		case '+': {
-			t.type = TOKEN_PLUS;
+			type = TOKEN_PLUS;
 		} break;
 
 		case '-': {
 			if (next(l) == '>') {
-				t.type = TOKEN_ARROW;
-				t.length = 2;
+				type = TOKEN_ARROW;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else {
-				t.type = TOKEN_MINUS;
+				type = TOKEN_MINUS;
 			}
 		} break;
 
 		case '*': {
-			t.type = TOKEN_STAR;
+			type = TOKEN_STAR;
 		} break;
 
 		case '/': {
-			t.type = TOKEN_SLASH;
+			type = TOKEN_SLASH;
 		} break;
 
 		case '%': {
-			t.type = TOKEN_PERCENT;
+			type = TOKEN_PERCENT;
 		} break;
 
 		case '=': {
 			if (next(l) == '=') {
-				t.type = TOKEN_EQ;
-				t.length = 2;
+				type = TOKEN_EQ;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else {
-				t.type = TOKEN_ASSIGN;
+				type = TOKEN_ASSIGN;
 			}
 		} break;
 
 		case '!': {
 			if (next(l) == '=') {
-				t.type = TOKEN_NEQ;
-				t.length = 2;
+				type = TOKEN_NEQ;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else {
-				t.type = TOKEN_NOT;
+				type = TOKEN_NOT;
 			}
 		} break;
 
 		case '<': {
 			if (next(l) == '=') {
-				t.type = TOKEN_LTE;
-				t.length = 2;
+				type = TOKEN_LTE;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else if (next(l) == '<') {
-				t.type = TOKEN_SHIFT_LEFT;
-				t.length = 2;
+				type = TOKEN_SHIFT_LEFT;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else {
-				t.type = TOKEN_LT;
+				type = TOKEN_LT;
 			}
 		} break;
 
 		case '>': {
 			if (next(l) == '=') {
-				t.type = TOKEN_GTE;
-				t.length = 2;
+				type = TOKEN_GTE;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else if (next(l) == '>') {
-				t.type = TOKEN_SHIFT_RIGHT;
-				t.length = 2;
+				type = TOKEN_SHIFT_RIGHT;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else {
-				t.type = TOKEN_GT;
+				type = TOKEN_GT;
 			}
 		} break;
 
 		case '&': {
 			if (next(l) == '&') {
-				t.type = TOKEN_AND;
-				t.length = 2;
+				type = TOKEN_AND;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else {
-				t.type = TOKEN_BIT_AND;
+				type = TOKEN_BIT_AND;
 			}
 		} break;
 
 		case '|': {
 			if (next(l) == '|') {
-				t.type = TOKEN_OR;
-				t.length = 2;
+				type = TOKEN_OR;
+				length = 2;
 				l->pos++;
-				l->column++;
 			} else {
-				t.type = TOKEN_BIT_OR;
+				type = TOKEN_BIT_OR;
 			}
 		} break;
 
 		case '^': {
-			t.type = TOKEN_BIT_XOR;
+			type = TOKEN_BIT_XOR;
 		} break;
 
 		case '~': {
-			t.type = TOKEN_BIT_NOT;
+			type = TOKEN_BIT_NOT;
 		} break;
 
 		case '(': {
-			t.type = TOKEN_LPAREN;
+			type = TOKEN_LPAREN;
 		} break;
 
 		case ')': {
-			t.type = TOKEN_RPAREN;
+			type = TOKEN_RPAREN;
 		} break;
 
 		case '{': {
-			t.type = TOKEN_LBRACE;
+			type = TOKEN_LBRACE;
 		} break;
 
 		case '}': {
-			t.type = TOKEN_RBRACE;
+			type = TOKEN_RBRACE;
 		} break;
 
 		case '[': {
-			t.type = TOKEN_LBRACKET;
+			type = TOKEN_LBRACKET;
 		} break;
 
 		case ']': {
-			t.type = TOKEN_RBRACKET;
+			type = TOKEN_RBRACKET;
 		} break;
 
 		case ';': {
-			t.type = TOKEN_SEMICOLON;
+			type = TOKEN_SEMICOLON;
 		} break;
 
 		case ',': {
-			t.type = TOKEN_COMMA;
+			type = TOKEN_COMMA;
 		} break;
 
 		case '.': {
-			t.type = TOKEN_DOT;
+			if (next(l) == '.') {
+				type = TOKEN_DOT_DOT;
+				length = 2;
+				l->pos++;
+			} else {
+				type = TOKEN_DOT;
+			}
 		} break;
 
 		case ':': {
-			t.type = TOKEN_COLON;
+			type = TOKEN_COLON;
 		} break;
 
 		case '?': {
-			t.type = TOKEN_QUESTION;
+			type = TOKEN_QUESTION;
 		} break;
 
 		default: {
-			logger(LOG_ERROR, "Unknown character '%c' at %zu:%zu\n", c, l->line,
-			       l->column);
+			size_t line, column;
+			tokenLocate(&tokens, l->pos, &line, &column);
+			logger(LOG_ERROR, "Unknown character '%c' at %zu:%zu\n", c, line,
+			       column);
 			l->pos++;
-			l->column++;
 			continue;
 		}
 		}
 
-		tokenPush(&tokens, t);
+		tokenPush(&tokens, type, start, length);
 		l->pos++;
-		l->column += t.length;
-	}
-
-	// Parte 2: transformar identifiers em keywords
-	for (size_t i = 0; i < tokens.count; i++) {
-		Token *t = &tokens.data[i];
-		for (size_t j = 0; keywords[j].name; j++) {
-			size_t keywordlen = strlen(keywords[j].name);
-			if (t->length != keywordlen)
-				continue;
-
-			if (strncmp(t->start, keywords[j].name, keywordlen) == 0) {
-				t->type = keywords[j].type;
-			}
-		}
 	}
 
 	return tokens;
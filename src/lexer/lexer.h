@@ -14,8 +14,6 @@ typedef struct {
 	const char *content;
 	size_t contentSize;
 	size_t pos;
-	size_t line;
-	size_t column;
 } Lexer;
 
 bool lexerValidate(Lexer *l);
@@ -0,0 +1,152 @@
+/**
+ * number.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "number.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Potências de 10 representáveis exatamente em um double
+static const double powersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+#define MAX_EXACT_POWER 22
+#define MAX_EXACT_MANTISSA (1ull << 53)
+#define MAX_MANTISSA_DIGITS 19
+
+static bool isDigit(char c) { return (unsigned)(c - '0') < 10; }
+
+// Valor de um dígito na base, ou -1 se não for dígito dela
+static int digitValue(char c, unsigned base) {
+	unsigned value;
+	if (isDigit(c))
+		value = (unsigned)(c - '0');
+	else if ((unsigned)((c | 0x20) - 'a') < 6)
+		value = (unsigned)((c | 0x20) - 'a') + 10;
+	else
+		return -1;
+
+	return value < base ? (int)value : -1;
+}
+
+// Inteiro decimal, octal (0...) ou hexadecimal (0x...), como strtoll base 0
+// Satura em LLONG_MAX, igual ao strtoll
+static size_t numberInteger(const char *start, size_t length,
+                            long long *value) {
+	unsigned base = 10;
+	size_t i = 0;
+	if (start[0] == '0') {
+		base = 8;
+		if (length > 2 && (start[1] | 0x20) == 'x' &&
+		    digitValue(start[2], 16) >= 0) {
+			base = 16;
+			i = 2;
+		}
+	}
+
+	unsigned long long result = 0;
+	bool overflow = false;
+	for (; i < length; i++) {
+		int digit = digitValue(start[i], base);
+		if (digit < 0)
+			break;
+		if (result > ((unsigned long long)LLONG_MAX - (unsigned)digit) / base)
+			overflow = true;
+		else
+			result = result * base + (unsigned)digit;
+	}
+
+	*value = overflow ? LLONG_MAX : (long long)result;
+	return i;
+}
+
+// Float pelo strtod, para os casos fora do caminho rápido
+static size_t numberFloatSlow(const char *start, double *value) {
+	char *end;
+	*value = strtod(start, &end);
+	return (size_t)(end - start);
+}
+
+// Float decimal: dígitos, '.', dígitos e expoente opcional
+// Mantissa de até 19 dígitos que cabe em 53 bits e expoente de até 22
+// são exatos com uma multiplicação ou divisão (caminho rápido de Clinger)
+static size_t numberFloat(const char *start, size_t length, double *value) {
+	// Float hexadecimal
+	if (length > 1 && start[0] == '0' && (start[1] | 0x20) == 'x')
+		return numberFloatSlow(start, value);
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	long exponent = 0;
+	size_t i = 0;
+
+	for (; i < length && isDigit(start[i]); i++) {
+		if (mantissa || start[i] != '0')
+			digits++;
+		mantissa = mantissa * 10 + (uint64_t)(start[i] - '0');
+		if (digits > MAX_MANTISSA_DIGITS)
+			return numberFloatSlow(start, value);
+	}
+
+	if (i < length && start[i] == '.') {
+		for (i++; i < length && isDigit(start[i]); i++) {
+			if (mantissa || start[i] != '0')
+				digits++;
+			mantissa = mantissa * 10 + (uint64_t)(start[i] - '0');
+			exponent--;
+			if (digits > MAX_MANTISSA_DIGITS)
+				return numberFloatSlow(start, value);
+		}
+	}
+
+	// Expoente só conta se tiver pelo menos um dígito
+	if (i < length && (start[i] | 0x20) == 'e') {
+		size_t j = i + 1;
+		bool negative = false;
+		if (j < length && (start[j] == '+' || start[j] == '-'))
+			negative = start[j++] == '-';
+
+		if (j < length && isDigit(start[j])) {
+			long power = 0;
+			for (; j < length && isDigit(start[j]); j++) {
+				if (power < 100000)
+					power = power * 10 + (start[j] - '0');
+			}
+			exponent += negative ? -power : power;
+			i = j;
+		}
+	}
+
+	if (mantissa > MAX_EXACT_MANTISSA || exponent > MAX_EXACT_POWER ||
+	    exponent < -MAX_EXACT_POWER)
+		return numberFloatSlow(start, value);
+
+	double result = (double)mantissa;
+	if (exponent < 0)
+		result /= powersOfTen[-exponent];
+	else
+		result *= powersOfTen[exponent];
+
+	*value = result;
+	return i;
+}
+
+// Lê um literal numérico que começa com um dígito
+// Retorna o tamanho do literal, o valor vai em number
+// É float se o inteiro for seguido de '.', mas não de '..' (intervalo)
+size_t numberParse(const char *start, size_t length, TokenNumber *number,
+                   bool *isFloat) {
+	size_t end = numberInteger(start, length, &number->integer);
+	if (end >= length || start[end] != '.' ||
+	    (end + 1 < length && start[end + 1] == '.')) {
+		*isFloat = false;
+		return end;
+	}
+
+	*isFloat = true;
+	return numberFloat(start, length, &number->floating);
+}
@@ -0,0 +1,17 @@
+/**
+ * number.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "token.h"
+
+// Literais numéricos
+// Inteiros seguem o strtoll com base 0, floats decimais usam um caminho
+// exato sem o strtod quando dá
+
+size_t numberParse(const char *start, size_t length, TokenNumber *number,
+                   bool *isFloat);
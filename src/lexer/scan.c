@@ -0,0 +1,157 @@
+/**
+ * scan.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "scan.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) &&     \
+    defined(__GNUC__) && !defined(VUL_SCAN_SCALAR)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+// Funções escolhidas pelo scanInit
+typedef struct {
+	size_t (*find)(const char *start, size_t length, char c);
+	size_t (*identifier)(const char *start, size_t length);
+	size_t (*whitespace)(const char *start, size_t length);
+} ScanBackend;
+
+// Letra, dígito ou _
+static bool isIdentifierChar(unsigned char c) {
+	return (unsigned)((c | 0x20) - 'a') < 26 || (unsigned)(c - '0') < 10 ||
+	       c == '_';
+}
+
+static bool isWhitespace(unsigned char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static size_t findScalar(const char *start, size_t length, char c) {
+	for (size_t i = 0; i < length; i++) {
+		if (start[i] == c)
+			return i;
+	}
+	return length;
+}
+
+static size_t identifierScalar(const char *start, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		if (!isIdentifierChar((unsigned char)start[i]))
+			return i;
+	}
+	return length;
+}
+
+static size_t whitespaceScalar(const char *start, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		if (!isWhitespace((unsigned char)start[i]))
+			return i;
+	}
+	return length;
+}
+
+#ifdef SCAN_X86
+// Gera as três funções para uma largura de vetor
+// Os blocos inteiros vão no vetor, o resto no escalar
+// Uma faixa [lo, hi] vira uma comparação sem sinal: (v - lo) -sat (hi - lo)
+#define SCAN_KERNELS(suffix, target, Vec, WIDTH, LOAD, SET1, EQ, OR, SUB,     \
+                     SUBS, ZERO, MASK)                                         \
+	target static size_t find##suffix(const char *start, size_t length,       \
+	                                  char c) {                                \
+		Vec needle = SET1(c);                                                  \
+		size_t i = 0;                                                          \
+		for (; i + WIDTH <= length; i += WIDTH) {                              \
+			uint32_t mask = (uint32_t)MASK(EQ(LOAD(start + i), needle));       \
+			if (mask)                                                          \
+				return i + (size_t)__builtin_ctz(mask);                        \
+		}                                                                      \
+		return i + findScalar(start + i, length - i, c);                       \
+	}                                                                          \
+                                                                               \
+	target static size_t identifier##suffix(const char *start,                \
+	                                        size_t length) {                   \
+		Vec lower = SET1('a'), letters = SET1('z' - 'a');                      \
+		Vec zero = SET1('0'), digits = SET1('9' - '0');                        \
+		Vec underscore = SET1('_'), caseBit = SET1(0x20), none = ZERO();       \
+		uint32_t full = (uint32_t)((1ull << WIDTH) - 1);                       \
+		size_t i = 0;                                                          \
+		for (; i + WIDTH <= length; i += WIDTH) {                              \
+			Vec v = LOAD(start + i);                                           \
+			Vec letter =                                                       \
+			    EQ(SUBS(SUB(OR(v, caseBit), lower), letters), none);           \
+			Vec digit = EQ(SUBS(SUB(v, zero), digits), none);                  \
+			Vec ok = OR(OR(letter, digit), EQ(v, underscore));                 \
+			uint32_t mask = ~(uint32_t)MASK(ok) & full;                        \
+			if (mask)                                                          \
+				return i + (size_t)__builtin_ctz(mask);                        \
+		}                                                                      \
+		return i + identifierScalar(start + i, length - i);                    \
+	}                                                                          \
+                                                                               \
+	target static size_t whitespace##suffix(const char *start,                \
+	                                        size_t length) {                   \
+		Vec space = SET1(' '), tab = SET1('\t');                               \
+		Vec carriage = SET1('\r'), newline = SET1('\n');                       \
+		uint32_t full = (uint32_t)((1ull << WIDTH) - 1);                       \
+		size_t i = 0;                                                          \
+		for (; i + WIDTH <= length; i += WIDTH) {                              \
+			Vec v = LOAD(start + i);                                           \
+			Vec ok = OR(OR(EQ(v, space), EQ(v, tab)),                          \
+			            OR(EQ(v, carriage), EQ(v, newline)));                  \
+			uint32_t mask = ~(uint32_t)MASK(ok) & full;                        \
+			if (mask)                                                          \
+				return i + (size_t)__builtin_ctz(mask);                        \
+		}                                                                      \
+		return i + whitespaceScalar(start + i, length - i);                    \
+	}
+
+#define SSE2_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define AVX2_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+
+SCAN_KERNELS(Sse2, , __m128i, 16, SSE2_LOAD, _mm_set1_epi8, _mm_cmpeq_epi8,
+             _mm_or_si128, _mm_sub_epi8, _mm_subs_epu8, _mm_setzero_si128,
+             _mm_movemask_epi8)
+
+SCAN_KERNELS(Avx2, __attribute__((target("avx2"))), __m256i, 32, AVX2_LOAD,
+             _mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_or_si256,
+             _mm256_sub_epi8, _mm256_subs_epu8, _mm256_setzero_si256,
+             _mm256_movemask_epi8)
+
+#undef SCAN_KERNELS
+#undef SSE2_LOAD
+#undef AVX2_LOAD
+#endif
+
+static ScanBackend backend = {findScalar, identifierScalar, whitespaceScalar};
+
+// Escolhe a implementação pela CPU
+void scanInit(void) {
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		backend = (ScanBackend){findAvx2, identifierAvx2, whitespaceAvx2};
+	} else {
+		backend = (ScanBackend){findSse2, identifierSse2, whitespaceSse2};
+	}
+#endif
+}
+
+// Índice do primeiro c, ou length se não tiver
+size_t scanFind(const char *start, size_t length, char c) {
+	return backend.find(start, length, c);
+}
+
+// Tamanho do trecho de letras, dígitos e _ no início
+size_t scanIdentifier(const char *start, size_t length) {
+	return backend.identifier(start, length);
+}
+
+// Tamanho do trecho de espaços, tabs e quebras de linha no início
+size_t scanWhitespace(const char *start, size_t length) {
+	return backend.whitespace(start, length);
+}
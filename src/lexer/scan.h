@@ -0,0 +1,16 @@
+/**
+ * scan.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stddef.h>
+
+// Varredura em blocos para o lexer
+// Usa AVX2 ou SSE2 quando a CPU tem, senão o caminho escalar
+
+void scanInit(void);
+
+size_t scanFind(const char *start, size_t length, char c);
+size_t scanIdentifier(const char *start, size_t length);
+size_t scanWhitespace(const char *start, size_t length);
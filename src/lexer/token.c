@@ -6,39 +6,137 @@
 #include "token.h"
 
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 #include "util.h"
 
-// Inicia um TokenArray
-void tokenInit(TokenArray *arr) {
-	arr->count = 0;
-	arr->capacity = 64;
-	arr->data = (Token *)malloc(arr->capacity * sizeof(Token));
+// Realoca os arrays de um TokenArray para capacity tokens
+static bool tokenReserve(TokenArray *arr, size_t capacity) {
+	uint8_t *types = (uint8_t *)realloc(arr->types, capacity);
+	if (!types)
+		return false;
+	arr->types = types;
+
+	uint32_t *starts =
+	    (uint32_t *)realloc(arr->starts, capacity * sizeof(uint32_t));
+	if (!starts)
+		return false;
+	arr->starts = starts;
+
+	uint32_t *lengths =
+	    (uint32_t *)realloc(arr->lengths, capacity * sizeof(uint32_t));
+	if (!lengths)
+		return false;
+	arr->lengths = lengths;
+
+	uint32_t *values =
+	    (uint32_t *)realloc(arr->values, capacity * sizeof(uint32_t));
+	if (!values)
+		return false;
+	arr->values = values;
+
+	arr->capacity = capacity;
+	return true;
+}
 
-	if (!arr->data) {
+// Inicia um TokenArray sobre um código fonte
+void tokenInit(TokenArray *arr, const char *content, size_t contentSize) {
+	arr->content = content;
+	arr->contentSize = contentSize;
+	arr->types = NULL;
+	arr->starts = NULL;
+	arr->lengths = NULL;
+	arr->values = NULL;
+	arr->count = 0;
+	arr->capacity = 0;
+	arr->numbers = NULL;
+	arr->numberCount = 0;
+	arr->numberCapacity = 0;
+	arr->lineStarts = NULL;
+	arr->lineCount = 0;
+	arr->lineCapacity = 0;
+
+	if (!tokenReserve(arr, 64)) {
 		logger(LOG_ERROR, "Failed to alocate token array data\n");
 		return;
 	}
+
+	// A primeira linha começa no offset 0
+	tokenPushLine(arr, 0);
 }
 
 // Adiciona um token a um TokenArray
-void tokenPush(TokenArray *arr, Token t) {
+// start é o offset do lexema em content
+void tokenPush(TokenArray *arr, TokenType type, size_t start, size_t length) {
 	if (!arr) {
 		logger(LOG_ERROR, "Failed to push token: array is NULL\n");
 		return;
 	}
 
 	if (arr->count >= arr->capacity) {
-		arr->capacity *= 2;
-		arr->data = (Token *)realloc(arr->data, arr->capacity * sizeof(Token));
-		if (!arr->data) {
+		if (!tokenReserve(arr, arr->capacity * 2)) {
 			logger(LOG_ERROR, "Failed to realloc token array data");
 			return;
 		}
 	}
 
-	arr->data[arr->count++] = t;
+	arr->types[arr->count] = (uint8_t)type;
+	arr->starts[arr->count] = (uint32_t)start;
+	arr->lengths[arr->count] = (uint32_t)length;
+	arr->values[arr->count] = 0;
+	arr->count++;
+}
+
+// Adiciona um literal numérico já decodificado
+void tokenPushNumber(TokenArray *arr, TokenType type, size_t start,
+                     size_t length, TokenNumber number) {
+	if (arr->numberCount >= arr->numberCapacity) {
+		size_t capacity = arr->numberCapacity ? arr->numberCapacity * 2 : 64;
+		TokenNumber *numbers = (TokenNumber *)realloc(
+		    arr->numbers, capacity * sizeof(TokenNumber));
+		if (!numbers) {
+			logger(LOG_ERROR, "Failed to realloc token number pool");
+			return;
+		}
+		arr->numbers = numbers;
+		arr->numberCapacity = capacity;
+	}
+
+	size_t index = arr->count;
+	tokenPush(arr, type, start, length);
+	if (arr->count == index)
+		return;
+
+	arr->values[index] = (uint32_t)arr->numberCount;
+	arr->numbers[arr->numberCount++] = number;
+}
+
+// Adiciona um identificador já internado
+void tokenPushSymbol(TokenArray *arr, size_t start, size_t length,
+                     Symbol symbol) {
+	size_t index = arr->count;
+	tokenPush(arr, TOKEN_IDENTIFIER, start, length);
+	if (arr->count > index)
+		arr->values[index] = symbol;
+}
+
+// Registra o início de uma linha
+// As linhas chegam em ordem, então o array fica ordenado
+void tokenPushLine(TokenArray *arr, size_t start) {
+	if (arr->lineCount >= arr->lineCapacity) {
+		size_t capacity = arr->lineCapacity ? arr->lineCapacity * 2 : 256;
+		uint32_t *lineStarts = (uint32_t *)realloc(
+		    arr->lineStarts, capacity * sizeof(uint32_t));
+		if (!lineStarts) {
+			logger(LOG_ERROR, "Failed to realloc token line table");
+			return;
+		}
+		arr->lineStarts = lineStarts;
+		arr->lineCapacity = capacity;
+	}
+
+	arr->lineStarts[arr->lineCount++] = (uint32_t)start;
 }
 
 // Limpa um TokenArray
@@ -48,53 +146,78 @@ void tokenDestroy(TokenArray *arr) {
 		return;
 	}
 
-	free(arr->data);
-	arr->data = NULL;
+	free(arr->types);
+	free(arr->starts);
+	free(arr->lengths);
+	free(arr->values);
+	free(arr->numbers);
+	free(arr->lineStarts);
+	arr->types = NULL;
+	arr->starts = NULL;
+	arr->lengths = NULL;
+	arr->values = NULL;
+	arr->numbers = NULL;
+	arr->lineStarts = NULL;
 	arr->count = 0;
 	arr->capacity = 0;
+	arr->numberCount = 0;
+	arr->numberCapacity = 0;
+	arr->lineCount = 0;
+	arr->lineCapacity = 0;
+}
+
+// Linha e coluna de um offset no código
+// Busca binária pela última linha que começa antes do offset
+void tokenLocate(const TokenArray *arr, size_t offset, size_t *line,
+                 size_t *column) {
+	size_t low = 0;
+	size_t high = arr->lineCount;
+	while (high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+		if (arr->lineStarts[middle] <= offset)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	*line = low + 1;
+	*column = offset - arr->lineStarts[low] + 1;
+}
+
+// Linha e coluna de um token
+void tokenPosition(Token t, size_t *line, size_t *column) {
+	tokenLocate(t.array, t.array->starts[t.index], line, column);
 }
 
 // Token Dump
 void tokenDump(TokenArray *arr) {
-	if (!arr || !arr->data) {
+	if (!arr || !arr->types) {
 		return;
 	}
 
 	for (size_t i = 0; i < arr->count; i++) {
-		Token t = arr->data[i];
+		Token t = tokenAt(arr, i);
+		size_t line, column;
+		tokenPosition(t, &line, &column);
 		logger(LOG_INFO,
 		       "Token %zu: type=%d, lexeme=%.*s, line=%zu, column=%zu\n", i,
-		       t.type, (int)t.length, t.start, t.line, t.column);
+		       tokenType(t), (int)tokenLength(t), tokenStart(t), line, column);
 	}
 }
 
 // Retorna o ponteiro do inicio de uma linha espeçífica
-const char *getLine(const char *content, size_t line, size_t *length) {
-	if (!content)
-		return NULL;
-	if (!length)
+// line começa em 0, o tamanho não inclui o '\n'
+const char *getLine(const TokenArray *arr, size_t line, size_t *length) {
+	if (!arr || !length)
 		return NULL;
-
-	while (*content && line > 0) {
-		if (*content == '\n') {
-			line--;
-		}
-
-		content++;
-	}
-
-	if (line != 0)
+	if (line >= arr->lineCount)
 		return NULL;
 
-	const char *start = content;
-	*length = 0;
-
-	while (*content && *content != '\n') {
-		(*length)++;
-		content++;
-	}
-
-	return start;
+	size_t start = arr->lineStarts[line];
+	size_t end = line + 1 < arr->lineCount ? arr->lineStarts[line + 1] - 1
+	                                       : arr->contentSize;
+	*length = end - start;
+	return arr->content + start;
 }
 
 // Faz um log de token
@@ -125,8 +248,12 @@ int tokenLogger(LogLevel level, Token t, const char *format, ...) {
 	} break;
 	}
 
+	size_t lineNumber, column;
+	tokenPosition(t, &lineNumber, &column);
+
 	// Imprimir erro
-	printf("%s[%s] in line %zu, column %zu: ", color, label, t.line, t.column);
+	printf("%s[%s] in line %zu, column %zu: ", color, label, lineNumber,
+	       column);
 
 	va_list args;
 	va_start(args, format);
@@ -136,7 +263,7 @@ int tokenLogger(LogLevel level, Token t, const char *format, ...) {
 	printf("\n");
 
 	size_t lineLength = 0;
-	const char *line = getLine(t.content, t.line - 1, &lineLength);
+	const char *line = getLine(t.array, lineNumber - 1, &lineLength);
 
 	// Apontar erro
 	if (!line || lineLength == 0)
@@ -154,11 +281,11 @@ int tokenLogger(LogLevel level, Token t, const char *format, ...) {
 
 	putchar('\n');
 
-	for (size_t i = 0; i < t.column - 1; i++) {
+	for (size_t i = 0; i < column - 1; i++) {
 		putchar(' ');
 	}
 
-	for (size_t i = 0; i < t.length; i++) {
+	for (size_t i = 0; i < tokenLength(t); i++) {
 		putchar('^');
 	}
 
@@ -5,7 +5,9 @@
  */
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
+#include "../symbol.h"
 #include "../util.h"
 
 // Tipo de token
@@ -51,6 +53,7 @@ typedef enum {
 	TOKEN_SEMICOLON,
 	TOKEN_COMMA,
 	TOKEN_DOT,
+	TOKEN_DOT_DOT, // Intervalo: a..b
 	TOKEN_COLON,
 
 	TOKEN_QUESTION,
@@ -69,31 +72,87 @@ typedef enum {
 	TOKEN_KEYWORD_ELSE,
 
     TOKEN_KEYWORD_WHILE,
+	TOKEN_KEYWORD_FOR,
+	TOKEN_KEYWORD_IN,
 
 	TOKEN_KEYWORD_VAR,
 	TOKEN_KEYWORD_FN,
-	TOKEN_KEYWORD_RETURN
+	TOKEN_KEYWORD_RETURN,
+
+	TOKEN_COUNT // Não é um token, tamanho das tabelas por tipo
 } TokenType;
 
-// Token
-typedef struct {
-	TokenType type;
-	const char *content;
-	const char *start;
-	size_t length;
-	size_t line;
-	size_t column;
-} Token;
+// Valor de um literal numérico, decodificado pelo lexer
+typedef union {
+	long long integer;
+	double floating;
+} TokenNumber;
 
 // TokenArray
+// Struct of arrays: o parser só lê types no peek/check/match
+// Posições são offsets de 32 bits em content, linha e coluna saem do offset
+// lineStarts guarda o offset do início de cada linha, montado pelo lexer
 typedef struct {
-	Token *data;
+	const char *content;
+	size_t contentSize;
+	uint8_t *types;
+	uint32_t *starts;
+	uint32_t *lengths;
+	uint32_t *values; // Números: índice em numbers, identificadores: Symbol
 	size_t count;
 	size_t capacity;
+	TokenNumber *numbers;
+	size_t numberCount;
+	size_t numberCapacity;
+	uint32_t *lineStarts;
+	size_t lineCount;
+	size_t lineCapacity;
 } TokenArray;
 
-void tokenInit(TokenArray *arr);
-void tokenPush(TokenArray *arr, Token t);
+// Referência a um token dentro de um TokenArray
+// array NULL é a ausência de token
+typedef struct {
+	const TokenArray *array;
+	uint32_t index;
+} Token;
+
+#define TOKEN_NONE ((Token){NULL, 0})
+
+void tokenInit(TokenArray *arr, const char *content, size_t contentSize);
+void tokenPush(TokenArray *arr, TokenType type, size_t start, size_t length);
+void tokenPushNumber(TokenArray *arr, TokenType type, size_t start,
+                     size_t length, TokenNumber number);
+void tokenPushSymbol(TokenArray *arr, size_t start, size_t length,
+                     Symbol symbol);
+void tokenPushLine(TokenArray *arr, size_t start);
 void tokenDestroy(TokenArray *arr);
 void tokenDump(TokenArray *arr);
 int tokenLogger(LogLevel level, Token t, const char *format, ...);
+
+void tokenLocate(const TokenArray *arr, size_t offset, size_t *line,
+                 size_t *column);
+void tokenPosition(Token t, size_t *line, size_t *column);
+
+// Token na posição index
+static inline Token tokenAt(const TokenArray *arr, size_t index) {
+	return (Token){arr, (uint32_t)index};
+}
+
+static inline TokenType tokenType(Token t) {
+	return (TokenType)t.array->types[t.index];
+}
+
+// Início do lexema no código fonte
+static inline const char *tokenStart(Token t) {
+	return t.array->content + t.array->starts[t.index];
+}
+
+static inline size_t tokenLength(Token t) { return t.array->lengths[t.index]; }
+
+// Símbolo de um TOKEN_IDENTIFIER
+static inline Symbol tokenSymbol(Token t) { return t.array->values[t.index]; }
+
+// Valor de um TOKEN_NUMBER_INTEGER ou TOKEN_NUMBER_FLOAT
+static inline TokenNumber tokenNumber(Token t) {
+	return t.array->numbers[t.array->values[t.index]];
+}
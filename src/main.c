@@ -3,7 +3,7 @@
  * Criado por Matheus Leme Da Silva
  * Licença MIT
  */
-#include <errno.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,73 +12,120 @@
 #include "eval/arena.h"
 #include "eval/environment.h"
 #include "eval/eval.h"
+#include "eval/gc.h"
+#include "eval/resolver.h"
 #include "lexer/lexer.h"
 #include "lexer/token.h"
 #include "parser/ast.h"
+#include "parser/flat.h"
 #include "parser/parser.h"
+#include "source.h"
+#include "symbol.h"
 #include "util.h"
+#include "vm/chunk.h"
+#include "vm/compiler.h"
+#include "vm/vm.h"
+
+// Motor de execução
+typedef enum {
+	ENGINE_AST, // Interpretador da ast, o de referência
+	ENGINE_VM   // Bytecode de registradores
+} Engine;
+
+// Espaço reservado para os envs das chamadas
+#define FRAME_STACK_SIZE (64 * 1024 * 1024)
 
 // Imprime help
 void help(char *argv0) {
-	logger(LOG_INFO, "Usage: %s <FILE | commands>\n", argv0);
-	logger(LOG_INFO, "Commands: help, version\n", argv0);
+	logger(LOG_INFO, "Usage: %s [options] <FILE | commands>\n", argv0);
+	logger(LOG_INFO, "Commands: help, version\n");
+	logger(LOG_INFO, "Options: --engine=ast|vm, --gc-stats, --no-mmap\n");
 }
+
+// Executa a ast com a VM
+Value runVM(AstNode *root, Arena *arena) {
+	VM *vm = vmCreate(arena);
+	if (!vm) {
+		logger(LOG_ERROR, "Failed to create vm\n");
+		return errorSignal();
+	}
+
+	Chunk *chunk = compilerCompile(root, vm);
+	if (!chunk) {
+		logger(LOG_ERROR, "Failed to compile\n");
+		vmDestroy(vm);
+		return errorSignal();
+	}
+
+	Value ret = vmRun(vm, chunk);
+
+	chunkDestroy(chunk);
+	vmDestroy(vm);
+	return ret;
+}
+
 // Func principal
 int main(int argc, char **argv) {
-	if (argc < 2) {
+	Engine engine = ENGINE_AST;
+	bool gcStats = false;
+	bool useMmap = true;
+	char *filename = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--engine=", 9) == 0) {
+			const char *name = argv[i] + 9;
+			if (strcmp(name, "ast") == 0) {
+				engine = ENGINE_AST;
+			} else if (strcmp(name, "vm") == 0) {
+				engine = ENGINE_VM;
+			} else {
+				logger(LOG_ERROR, "Unknown engine: %s\n", name);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--gc-stats") == 0) {
+			gcStats = true;
+		} else if (strcmp(argv[i], "--no-mmap") == 0) {
+			useMmap = false;
+		} else if (strncmp(argv[i], "--", 2) == 0) {
+			logger(LOG_ERROR, "Unknown option: %s\n", argv[i]);
+			return 1;
+		} else if (!filename) {
+			filename = argv[i];
+		}
+	}
+
+	if (!filename) {
 		logger(LOG_ERROR, "File is required\n");
-		
+
 		return 1;
 	}
 
-	if (strcmp(argv[1], "help") == 0) {
+	if (strcmp(filename, "help") == 0) {
 		help(argv[0]);
 		exit(0);
-	} else if (strcmp(argv[1], "version") == 0) {
+	} else if (strcmp(filename, "version") == 0) {
 		printf("%s v%s\n", argv[0], VERSION_STRING);
 		exit(0);
 	}
 
-	char *filename = argv[1];
-	FILE *f = fopen(filename, "r");
-
-	if (!f) { // Ver se falhou ao abrir o arquivo
-		logger(LOG_ERROR, "Failed to open %s: %s\n", filename, strerror(errno));
+	// O lexer lê direto do arquivo mapeado, sem copiar
+	Source source = {0};
+	if (!sourceLoad(&source, filename, useMmap))
 		return 1;
-	}
 
-	long filesize = fsize(f);
-
-	char *content = (char *)malloc(filesize);
-	if (!content) { // Ver se falhou ao alocar memoria para arquivo
-		logger(LOG_ERROR, "Failed to alloc memory for the file\n");
-		fclose(f);
-		return 1;
-	}
-
-	// Ler essa merda
-	if (fread(content, 1, filesize, f) != (size_t)filesize) {
-		logger(LOG_ERROR, "Failed to read file: %s:%s\n", filename,
-		       strerror(errno));
-		free(content);
-		return 1;
-	}
-
-	Lexer *lexer = lexerCreate(content, filesize);
+	Lexer *lexer = lexerCreate(source.content, source.size);
 	if (!lexerValidate(lexer)) {
 		logger(LOG_ERROR, "Failed to create lexer\n");
-		free(content);
-		fclose(f);
+		sourceDestroy(&source);
 		return 1;
 	}
 	TokenArray tokens = lexerTokenize(lexer);
 
-	Parser *parser = parserCreate(tokens);
+	Parser *parser = parserCreate(&tokens);
 	if (!parserValidate(parser)) {
 		logger(LOG_ERROR, "Failed to create parser\n");
 		lexerDestroy(lexer);
-		free(content);
-		fclose(f);
+		sourceDestroy(&source);
 		return 1;
 	}
 
@@ -86,9 +133,9 @@ int main(int argc, char **argv) {
 	if (!root) {
 		logger(LOG_ERROR, "Failed to parse\n");
 		parserDestroy(parser);
+		tokenDestroy(&tokens);
 		lexerDestroy(lexer);
-		free(content);
-		fclose(f);
+		sourceDestroy(&source);
 		return 1;
 	}
 
@@ -97,30 +144,75 @@ int main(int argc, char **argv) {
 		logger(LOG_ERROR, "Failed to create arena allocator\n");
 		parserDestroy(parser);
 		lexerDestroy(lexer);
-		free(content);
-		fclose(f);
+		sourceDestroy(&source);
 		return 1;
 	}
 
-	Environment *environment = environmentCreate(32, NULL);
-	if (!environment) {
-		logger(LOG_ERROR, "Failed to create environment\n");
-		arenaDestroy(arena);
-		parserDestroy(parser);
-		lexerDestroy(lexer);
-		free(content);
-		fclose(f);
-		return 1;
+	Value ret;
+	if (engine == ENGINE_VM) {
+		ret = runVM(root, arena);
+	} else {
+		if (!resolverResolve(root)) {
+			logger(LOG_ERROR, "Failed to resolve\n");
+			arenaDestroy(arena);
+			parserDestroy(parser);
+			lexerDestroy(lexer);
+			sourceDestroy(&source);
+			return 1;
+		}
+
+		// O eval roda na ast compacta, a original não é mais usada
+		FlatAst *flat = flatCreate(root);
+		if (!flat) {
+			logger(LOG_ERROR, "Failed to flatten ast\n");
+			arenaDestroy(arena);
+			astDestroy(root);
+			parserDestroy(parser);
+			tokenDestroy(&tokens);
+			lexerDestroy(lexer);
+			sourceDestroy(&source);
+			return 1;
+		}
+		astDestroy(root);
+		root = NULL;
+
+		Environment *environment = environmentCreate(flat->slotCount, NULL);
+		if (environment)
+			environment->frames = frameStackCreate(FRAME_STACK_SIZE);
+		if (!environment) {
+			logger(LOG_ERROR, "Failed to create environment\n");
+			arenaDestroy(arena);
+			parserDestroy(parser);
+			lexerDestroy(lexer);
+			sourceDestroy(&source);
+			return 1;
+		}
+
+		ret = eval(flat, arena, environment);
+		frameStackDestroy(environment->frames);
+		environmentDestroy(environment);
+		flatDestroy(flat);
 	}
 
-	Value ret = eval(root, arena, environment);
+	// Erro em tempo de execução para o programa com status 1
+	// Calculado antes do gcDestroy: o inteiro pode estar no heap do GC
+	int status = 0;
+	if (VALUE_TYPE(ret) == VALUE_ERROR_SIGNAL)
+		status = 1;
+	else if (VALUE_TYPE(ret) == VALUE_INTEGER)
+		status = (int)AS_INTEGER(ret);
+
+	if (gcStats)
+		gcPrintStats();
 
-	environmentDestroy(environment);
+	gcDestroy();
 	arenaDestroy(arena);
 	astDestroy(root);
+	parserDestroy(parser);
 	tokenDestroy(&tokens);
+	symbolDestroy();
 	lexerDestroy(lexer);
-	fclose(f);
+	sourceDestroy(&source);
 
-	return ret.type == VALUE_INTEGER ? (int)ret.value.integer : 0;
+	return status;
 }
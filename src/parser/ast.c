@@ -8,6 +8,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "util.h"
 
@@ -15,13 +16,22 @@
 	for (int i = 0; i < (d); i++)                                              \
 		printf(" ");
 
+// Tipo genérico de um nó especializado pelo eval
+NodeType astGenericType(NodeType type) {
+	if (type >= NODE_BINARYOP_ADD_INT)
+		return NODE_BINARYOP;
+	if (type >= NODE_IDENTIFIER_LOCAL)
+		return NODE_IDENTIFIER;
+	return type;
+}
+
 // Imprime uma ast
 void astDump(AstNode *root, int depth) {
 	if (!root)
 		return;
 	INDENT(depth);
 
-	switch (root->type) {
+	switch (astGenericType(root->type)) {
 	case NODE_PROGRAM: {
 		printf("NODE_PROGRAM: \n");
 		for (size_t i = 0; i < root->data.program.count; i++)
@@ -89,6 +99,36 @@ void astDump(AstNode *root, int depth) {
 		printf("STATEMENT: \n");
 		astDump(root->data.fnStatement.statement, depth + 2);
 	} break;
+	case NODE_WHILE_STATEMENT: {
+		printf("NODE_WHILE_STATEMENT: \n");
+
+		INDENT(depth + 1);
+		printf("CONDITION: \n");
+		astDump(root->data.whileStatement.condition, depth + 2);
+
+		INDENT(depth + 1);
+		printf("STATEMENT: \n");
+		astDump(root->data.whileStatement.statement, depth + 2);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		printf("NODE_FOR_STATEMENT: \n");
+
+		INDENT(depth + 1);
+		printf("IDENTIFIER: \n");
+		astDump(root->data.forStatement.identifier, depth + 2);
+
+		INDENT(depth + 1);
+		printf("START: \n");
+		astDump(root->data.forStatement.start, depth + 2);
+
+		INDENT(depth + 1);
+		printf("END: \n");
+		astDump(root->data.forStatement.end, depth + 2);
+
+		INDENT(depth + 1);
+		printf("STATEMENT: \n");
+		astDump(root->data.forStatement.statement, depth + 2);
+	} break;
 	case NODE_NUMBER: {
 		if (!root->data.number.isFloat) {
 			printf("NODE_NUMBER: %lld\n", root->data.number.value.integer);
@@ -108,8 +148,9 @@ void astDump(AstNode *root, int depth) {
 		printf("NODE_NULL\n");
 	} break;
 	case NODE_IDENTIFIER: {
-		printf("NODE_IDENTIFIER: %.*s\n", (int)root->data.identifier.length,
-		       root->data.identifier.name);
+		printf("NODE_IDENTIFIER: %.*s\n",
+		       (int)symbolLength(root->data.identifier.symbol),
+		       symbolName(root->data.identifier.symbol));
 	} break;
 	case NODE_BINARYOP: {
 		printf("NODE_BINARYOP: \n");
@@ -124,6 +165,34 @@ void astDump(AstNode *root, int depth) {
 		INDENT(depth + 1);
 		printf("OPERATOR: %d", root->data.binaryOp.op);
 	} break;
+	case NODE_LOGICAL: {
+		printf("NODE_LOGICAL: \n");
+		INDENT(depth + 1);
+		printf("LEFT: \n");
+		astDump(root->data.binaryOp.left, depth + 2);
+
+		INDENT(depth + 1);
+		printf("RIGHT: \n");
+		astDump(root->data.binaryOp.right, depth + 2);
+
+		INDENT(depth + 1);
+		printf("OPERATOR: %d\n", root->data.binaryOp.op);
+	} break;
+	case NODE_CONDITIONAL: {
+		printf("NODE_CONDITIONAL: \n");
+
+		INDENT(depth + 1);
+		printf("CONDITION: \n");
+		astDump(root->data.conditional.condition, depth + 2);
+
+		INDENT(depth + 1);
+		printf("THEN: \n");
+		astDump(root->data.conditional.thenExpression, depth + 2);
+
+		INDENT(depth + 1);
+		printf("ELSE: \n");
+		astDump(root->data.conditional.elseExpression, depth + 2);
+	} break;
 
 	case NODE_UNARYOP: {
 		printf("NODE_UNARYOP: \n");
@@ -160,150 +229,85 @@ void astDump(AstNode *root, int depth) {
 		INDENT(depth + 1);
 		printf("ARGC: %zu\n", root->data.call.argc);
 	} break;
+	default:
+		break;
 	}
 	printf("\n");
 }
 
 // Destroi uma ast
+// Tudo vive na arena do programa, então sai de uma vez só
 void astDestroy(AstNode *root) {
-	if (!root)
+	if (!root || root->type != NODE_PROGRAM)
 		return;
 
-	switch (root->type) {
-	case NODE_PROGRAM: {
-		for (size_t i = 0; i < root->data.program.count; i++) {
-			astDestroy(root->data.program.statements[i]);
-		}
-	} break;
-	case NODE_BLOCK_STATEMENT: {
-		for (size_t i = 0; i < root->data.blockStatement.count; i++) {
-			astDestroy(root->data.blockStatement.statements[i]);
-		}
-	} break;
-	case NODE_EXPRESSION_STATEMENT: {
-		astDestroy(root->data.expressionStatement.expression);
-	} break;
-	case NODE_IF_STATEMENT: {
-		astDestroy(root->data.ifStatement.condition);
-		astDestroy(root->data.ifStatement.thenBranch);
-		astDestroy(root->data.ifStatement.elseBranch);
-	} break;
-	case NODE_RETURN_STATEMENT: {
-		astDestroy(root->data.returnStatement.statement);
-	} break;
-	case NODE_VAR_STATEMENT: {
-		astDestroy(root->data.varStatement.expression);
-		astDestroy(root->data.varStatement.identifier);
-	} break;
-	case NODE_FN_STATEMENT: {
-		for (size_t i = 0; i < root->data.fnStatement.paramCount; i++)
-			astDestroy(root->data.fnStatement.params[i]);
-		astDestroy(root->data.fnStatement.functionName);
-		astDestroy(root->data.fnStatement.statement);
-	} break;
-	case NODE_BINARYOP: {
-		astDestroy(root->data.binaryOp.left);
-		astDestroy(root->data.binaryOp.right);
-	} break;
-	case NODE_UNARYOP: {
-		astDestroy(root->data.unaryOp.operand);
-	} break;
-	case NODE_ASSIGNMENT: {
-		astDestroy(root->data.assigment.target);
-		astDestroy(root->data.assigment.value);
-	} break;
-	case NODE_CALL: {
-		astDestroy(root->data.call.callee);
-		for (size_t i = 0; i < root->data.call.argc; i++)
-			astDestroy(root->data.call.args[i]);
-	} break;
-	default:
-		break;
-	}
-
-	free(root);
+	arenaDestroy(root->data.program.arena);
 }
 
-// Cria um novo nó program
+// Cria um novo nó program, dono da arena da ast
 AstNode *astProgramCreate(void) {
-	AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-	if (!node)
+	Arena *arena = arenaCreate(64 * 1024);
+	if (!arena)
 		return NULL;
 
+	AstNode *node = (AstNode *)arenaAlloc(arena, sizeof(AstNode));
+	if (!node) {
+		arenaDestroy(arena);
+		return NULL;
+	}
+
 	node->type = NODE_PROGRAM;
-	node->data.program.count = 0;
-	node->data.program.capacity = 0;
+	node->token = TOKEN_NONE;
 	node->data.program.statements = NULL;
+	node->data.program.count = 0;
+	node->data.program.slotCount = 0;
+	node->data.program.arena = arena;
 	return node;
 }
 
-// Adiciona um nó filho em um nó program
-void astProgramPush(AstNode *program, AstNode *statement) {
-	// Verificação basica
-	if (!program || !statement)
-		return;
-	if (program->type != NODE_PROGRAM)
-		return;
-
-	if (program->data.program.count >= program->data.program.capacity) {
-		size_t newCapacity = (program->data.program.capacity == 0)
-		                         ? 8
-		                         : program->data.program.capacity * 2;
-
-		AstNode **newStatements = realloc(program->data.program.statements,
-		                                  newCapacity * sizeof(AstNode *));
-
-		if (!newStatements) {
-			logger(LOG_ERROR, "Failed to allocate memory for statements\n");
-			return;
-		}
-
-		program->data.program.capacity = newCapacity;
-		program->data.program.statements = newStatements;
-	}
-
-	program->data.program.statements[program->data.program.count++] = statement;
-}
+// Cria um nó na arena do programa
+// Só type e token são preenchidos, o resto fica com quem chamou
+AstNode *astNodeCreate(AstNode *program, NodeType type, Token token) {
+	if (!program || program->type != NODE_PROGRAM)
+		return NULL;
 
-// Cria um novo nó block
-AstNode *astBlockCreate(void) {
-	AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-	if (!node)
+	AstNode *node =
+	    (AstNode *)arenaAlloc(program->data.program.arena, sizeof(AstNode));
+	if (!node) {
+		logger(LOG_ERROR, "Failed to allocate memory for node\n");
 		return NULL;
+	}
 
-	node->type = NODE_BLOCK_STATEMENT;
-	node->data.blockStatement.count = 0;
-	node->data.blockStatement.capacity = 0;
-	node->data.blockStatement.statements = NULL;
+	node->type = type;
+	node->token = token;
 	return node;
 }
 
-// Adiciona um nó filho em um nó block
-void astBlockPush(AstNode *block, AstNode *statement) {
-	// Verificação basica
-	if (!block || !statement)
-		return;
-	if (block->type != NODE_BLOCK_STATEMENT)
-		return;
-
-	if (block->data.blockStatement.count >=
-	    block->data.blockStatement.capacity) {
-		size_t newCapacity = (block->data.blockStatement.capacity == 0)
-		                         ? 8
-		                         : block->data.blockStatement.capacity * 2;
+// Copia uma lista pronta de nós para a arena, no tamanho exato
+// Lista vazia retorna NULL
+AstNode **astProgramList(AstNode *program, AstNode **nodes, size_t count) {
+	if (!program || program->type != NODE_PROGRAM || count == 0)
+		return NULL;
 
-		AstNode **newStatements = realloc(block->data.blockStatement.statements,
-		                                  newCapacity * sizeof(AstNode *));
+	AstNode **list = (AstNode **)arenaAlloc(program->data.program.arena,
+	                                         count * sizeof(AstNode *));
+	if (!list) {
+		logger(LOG_ERROR, "Failed to allocate memory for statements\n");
+		return NULL;
+	}
 
-		if (!newStatements) {
-			logger(LOG_ERROR, "Failed to allocate memory for statements\n");
-			return;
-		}
+	memcpy(list, nodes, count * sizeof(AstNode *));
+	return list;
+}
 
-		block->data.blockStatement.capacity = newCapacity;
-		block->data.blockStatement.statements = newStatements;
-	}
+// Reserva length bytes para um literal na arena do programa
+// Os bytes ficam no lugar até o astDestroy do programa
+char *astProgramString(AstNode *program, size_t length) {
+	if (!program || program->type != NODE_PROGRAM)
+		return NULL;
 
-	block->data.blockStatement.statements[block->data.blockStatement.count++] =
-	    statement;
+	char *chars = (char *)arenaAlloc(program->data.program.arena, length);
+	if (!chars)
+		logger(LOG_ERROR, "Failed to allocate memory for strings\n");
+	return chars;
 }
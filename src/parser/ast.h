@@ -6,10 +6,18 @@
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
+#include "../eval/arena.h"
 #include "../lexer/token.h"
 #include "../util.h"
 
+struct String;
+
+// Endereço de um identificador quando não é local de uma função
+#define RESOLVE_DYNAMIC -1 // Procura pelo nome em tempo de execução
+#define RESOLVE_GLOBAL -2  // Slot no environment global
+
 // Tipo de nó
 typedef enum {
 	NODE_PROGRAM = 1,
@@ -19,6 +27,8 @@ typedef enum {
 	NODE_RETURN_STATEMENT,
 	NODE_VAR_STATEMENT,
 	NODE_FN_STATEMENT,
+	NODE_WHILE_STATEMENT,
+	NODE_FOR_STATEMENT,
 
 	// Literais
 	NODE_NUMBER,
@@ -33,27 +43,55 @@ typedef enum {
 	NODE_BINARYOP,
 	NODE_UNARYOP,
 	NODE_ASSIGNMENT,
-	NODE_CALL
+	NODE_CALL,
+	NODE_LOGICAL,     // and/or, o lado direito só roda se precisar
+	NODE_CONDITIONAL, // c ? a : b
+
+	// Só na ast compacta, marcado pelo flatCreate
+	NODE_RETURN_TAIL_CALL, // Return de uma chamada, dentro de função
+
+	// Especializados pelo eval (quickening), voltam ao genérico se errar
+	NODE_IDENTIFIER_LOCAL,
+	NODE_IDENTIFIER_GLOBAL,
+	NODE_BINARYOP_ADD_INT,
+	NODE_BINARYOP_SUB_INT,
+	NODE_BINARYOP_MUL_INT,
+	NODE_BINARYOP_DIV_INT,
+	NODE_BINARYOP_MOD_INT,
+	NODE_BINARYOP_EQ_INT,
+	NODE_BINARYOP_NEQ_INT,
+	NODE_BINARYOP_LT_INT,
+	NODE_BINARYOP_GT_INT,
+	NODE_BINARYOP_LTE_INT,
+	NODE_BINARYOP_GTE_INT,
+	NODE_BINARYOP_ADD_FLOAT,
+	NODE_BINARYOP_SUB_FLOAT,
+	NODE_BINARYOP_MUL_FLOAT,
+	NODE_BINARYOP_LT_FLOAT,
+	NODE_BINARYOP_GT_FLOAT,
+	NODE_BINARYOP_LTE_FLOAT,
+	NODE_BINARYOP_GTE_FLOAT
 } NodeType;
 
 // Nó
 typedef struct AstNode {
 	NodeType type;
-	Token *token;
+	Token token;
 
 	union {
 		// NODE_PROGRAM
+		// Dono da arena onde vivem todos os nós, listas e literais
 		struct {
 			struct AstNode **statements;
 			size_t count;
-			size_t capacity;
+			size_t slotCount; // Globais, preenchido pelo resolver
+			Arena *arena;
 		} program;
 
 		// NODE_BLOCK_STATEMENT
 		struct {
 			struct AstNode **statements;
 			size_t count;
-			size_t capacity;
 		} blockStatement;
 
 		// NODE_EXPRESSION_STATEMENT
@@ -85,8 +123,25 @@ typedef struct AstNode {
 			size_t paramCount;
 			struct AstNode *functionName; // NODE_IDENTIFIER
 			struct AstNode *statement;
+			size_t slotCount; // Params + locais, preenchido pelo resolver
+			bool hasClosure;  // Tem funções internas que capturam o env
 		} fnStatement;
 
+		// NODE_WHILE_STATEMENT
+		struct {
+			struct AstNode *condition;
+			struct AstNode *statement;
+		} whileStatement;
+
+		// NODE_FOR_STATEMENT
+		// for identifier in start..end, com end fora do intervalo
+		struct {
+			struct AstNode *identifier;
+			struct AstNode *start;
+			struct AstNode *end;
+			struct AstNode *statement;
+		} forStatement;
+
 		// NODE_NUMBER
 		struct {
 			bool isFloat;
@@ -97,9 +152,12 @@ typedef struct AstNode {
 		} number;
 
 		// NODE_STRING
+		// start aponta para o código fonte ou para a arena do programa,
+		// já com os escapes decodificados
 		struct {
 			const char *start;
 			size_t length;
+			struct String *literal; // Criada na primeira execução
 		} string;
 
 		// NODE_BOOLEAN
@@ -109,11 +167,12 @@ typedef struct AstNode {
 
 		// NODE_IDENTIFIER
 		struct {
-			const char *name;
-			size_t length;
+			Symbol symbol;
+			int depth; // Distância em funções ou RESOLVE_*
+			size_t slot;
 		} identifier;
 
-		// NODE_BINARYOP
+		// NODE_BINARYOP, NODE_LOGICAL
 		struct {
 			struct AstNode *left;
 			struct AstNode *right;
@@ -138,14 +197,21 @@ typedef struct AstNode {
 			struct AstNode **args;
 			size_t argc;
 		} call;
+
+		// NODE_CONDITIONAL
+		struct {
+			struct AstNode *condition;
+			struct AstNode *thenExpression;
+			struct AstNode *elseExpression;
+		} conditional;
 	} data;
 } AstNode;
 
+NodeType astGenericType(NodeType type);
 void astDump(AstNode *root, int depth);
 void astDestroy(AstNode *root);
 
 AstNode *astProgramCreate(void);
-void astProgramPush(AstNode *program, AstNode *statement);
-
-AstNode *astBlockCreate(void);
-void astBlockPush(AstNode *program, AstNode *statement);
+AstNode *astNodeCreate(AstNode *program, NodeType type, Token token);
+AstNode **astProgramList(AstNode *program, AstNode **nodes, size_t count);
+char *astProgramString(AstNode *program, size_t length);
@@ -0,0 +1,352 @@
+/**
+ * flat.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "flat.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+
+// Tamanho de cada tabela, contado antes de alocar
+typedef struct {
+	size_t nodes;
+	size_t lists;
+	size_t functions;
+	size_t strings;
+	size_t chars;
+} FlatCount;
+
+// Posição de escrita em cada tabela
+typedef struct {
+	FlatAst *ast;
+	size_t node;
+	size_t list;
+	size_t function;
+	size_t string;
+	char *chars;
+	bool inFunction; // Return pode virar chamada de cauda
+	bool failed;     // Faltou um filho obrigatório
+} FlatBuilder;
+
+// Conta o que uma ast vai ocupar
+static void flatCount(AstNode *node, FlatCount *count) {
+	if (!node)
+		return;
+	count->nodes++;
+
+	switch (node->type) {
+	case NODE_PROGRAM: {
+		count->lists += node->data.program.count;
+		for (size_t i = 0; i < node->data.program.count; i++)
+			flatCount(node->data.program.statements[i], count);
+	} break;
+	case NODE_BLOCK_STATEMENT: {
+		count->lists += node->data.blockStatement.count;
+		for (size_t i = 0; i < node->data.blockStatement.count; i++)
+			flatCount(node->data.blockStatement.statements[i], count);
+	} break;
+	case NODE_EXPRESSION_STATEMENT:
+		flatCount(node->data.expressionStatement.expression, count);
+		break;
+	case NODE_IF_STATEMENT: {
+		flatCount(node->data.ifStatement.condition, count);
+		flatCount(node->data.ifStatement.thenBranch, count);
+		flatCount(node->data.ifStatement.elseBranch, count);
+	} break;
+	case NODE_RETURN_STATEMENT:
+		flatCount(node->data.returnStatement.statement, count);
+		break;
+	case NODE_VAR_STATEMENT: {
+		flatCount(node->data.varStatement.identifier, count);
+		flatCount(node->data.varStatement.expression, count);
+	} break;
+	case NODE_FN_STATEMENT: {
+		count->functions++;
+		count->lists += node->data.fnStatement.paramCount;
+		for (size_t i = 0; i < node->data.fnStatement.paramCount; i++)
+			flatCount(node->data.fnStatement.params[i], count);
+		flatCount(node->data.fnStatement.functionName, count);
+		flatCount(node->data.fnStatement.statement, count);
+	} break;
+	case NODE_WHILE_STATEMENT: {
+		flatCount(node->data.whileStatement.condition, count);
+		flatCount(node->data.whileStatement.statement, count);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		count->lists += 4;
+		flatCount(node->data.forStatement.identifier, count);
+		flatCount(node->data.forStatement.start, count);
+		flatCount(node->data.forStatement.end, count);
+		flatCount(node->data.forStatement.statement, count);
+	} break;
+	case NODE_STRING: {
+		count->strings++;
+		count->chars += node->data.string.length;
+	} break;
+	case NODE_BINARYOP:
+	case NODE_LOGICAL: {
+		flatCount(node->data.binaryOp.left, count);
+		flatCount(node->data.binaryOp.right, count);
+	} break;
+	case NODE_CONDITIONAL: {
+		flatCount(node->data.conditional.condition, count);
+		flatCount(node->data.conditional.thenExpression, count);
+		flatCount(node->data.conditional.elseExpression, count);
+	} break;
+	case NODE_UNARYOP:
+		flatCount(node->data.unaryOp.operand, count);
+		break;
+	case NODE_ASSIGNMENT: {
+		flatCount(node->data.assigment.target, count);
+		flatCount(node->data.assigment.value, count);
+	} break;
+	case NODE_CALL: {
+		count->lists += node->data.call.argc;
+		flatCount(node->data.call.callee, count);
+		for (size_t i = 0; i < node->data.call.argc; i++)
+			flatCount(node->data.call.args[i], count);
+	} break;
+	default:
+		break;
+	}
+}
+
+static NodeIndex flatNode(FlatBuilder *b, AstNode *node);
+
+// Copia um filho obrigatório
+// Só else e o valor do return podem faltar; um NULL aqui é ast inválida
+// e não pode virar um nó que avalia para null
+static NodeIndex flatChild(FlatBuilder *b, AstNode *node) {
+	if (!node) {
+		b->failed = true;
+		return NODE_INDEX_NONE;
+	}
+	return flatNode(b, node);
+}
+
+// Reserva uma lista em lists e preenche com os filhos
+static uint32_t flatList(FlatBuilder *b, AstNode **nodes, size_t count) {
+	uint32_t first = (uint32_t)b->list;
+	b->list += count;
+	for (size_t i = 0; i < count; i++)
+		b->ast->lists[first + i] = flatChild(b, nodes[i]);
+	return first;
+}
+
+// Copia um nó e seus filhos, o pai sempre antes dos filhos
+static NodeIndex flatNode(FlatBuilder *b, AstNode *node) {
+	if (!node)
+		return NODE_INDEX_NONE;
+
+	FlatAst *ast = b->ast;
+	NodeIndex index = (NodeIndex)b->node++;
+	FlatNode *flat = &ast->nodes[index];
+	memset(flat, 0, sizeof(FlatNode));
+	flat->type = (uint8_t)node->type;
+	ast->tokens[index] = node->token.index;
+	if (!ast->tokenArray)
+		ast->tokenArray = node->token.array;
+
+	switch (node->type) {
+	case NODE_PROGRAM: {
+		flat->data.list.count = (uint32_t)node->data.program.count;
+		flat->data.list.first = flatList(b, node->data.program.statements,
+		                                 node->data.program.count);
+	} break;
+	case NODE_BLOCK_STATEMENT: {
+		flat->data.list.count = (uint32_t)node->data.blockStatement.count;
+		flat->data.list.first =
+		    flatList(b, node->data.blockStatement.statements,
+		             node->data.blockStatement.count);
+	} break;
+	case NODE_EXPRESSION_STATEMENT:
+		flat->data.operand =
+		    flatChild(b, node->data.expressionStatement.expression);
+		break;
+	case NODE_IF_STATEMENT: {
+		flat->data.ifStatement.condition =
+		    flatChild(b, node->data.ifStatement.condition);
+		flat->data.ifStatement.thenBranch =
+		    flatChild(b, node->data.ifStatement.thenBranch);
+		flat->data.ifStatement.elseBranch =
+		    flatNode(b, node->data.ifStatement.elseBranch);
+	} break;
+	case NODE_RETURN_STATEMENT: {
+		AstNode *statement = node->data.returnStatement.statement;
+		if (b->inFunction && statement &&
+		    statement->type == NODE_EXPRESSION_STATEMENT &&
+		    statement->data.expressionStatement.expression &&
+		    statement->data.expressionStatement.expression->type == NODE_CALL)
+			flat->type = NODE_RETURN_TAIL_CALL;
+		flat->data.operand = flatNode(b, statement);
+	} break;
+	case NODE_VAR_STATEMENT: {
+		flat->data.varStatement.identifier =
+		    flatChild(b, node->data.varStatement.identifier);
+		flat->data.varStatement.expression =
+		    flatChild(b, node->data.varStatement.expression);
+	} break;
+	case NODE_FN_STATEMENT: {
+		uint32_t function = (uint32_t)b->function++;
+		FlatFunction *fn = &ast->functions[function];
+		fn->paramCount = (uint32_t)node->data.fnStatement.paramCount;
+		fn->slotCount = (uint32_t)node->data.fnStatement.slotCount;
+		fn->hasClosure = node->data.fnStatement.hasClosure;
+		fn->params = flatList(b, node->data.fnStatement.params,
+		                      node->data.fnStatement.paramCount);
+		fn->name = flatChild(b, node->data.fnStatement.functionName);
+		bool inFunction = b->inFunction;
+		b->inFunction = true;
+		fn->statement = flatChild(b, node->data.fnStatement.statement);
+		b->inFunction = inFunction;
+		flat->data.function = function;
+	} break;
+	case NODE_WHILE_STATEMENT: {
+		flat->data.whileStatement.condition =
+		    flatChild(b, node->data.whileStatement.condition);
+		flat->data.whileStatement.statement =
+		    flatChild(b, node->data.whileStatement.statement);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		AstNode *parts[] = {
+		    node->data.forStatement.identifier,
+		    node->data.forStatement.start,
+		    node->data.forStatement.end,
+		    node->data.forStatement.statement,
+		};
+		flat->data.forStatement.parts = flatList(b, parts, 4);
+	} break;
+	case NODE_NUMBER: {
+		TokenNumber number;
+		if (node->data.number.isFloat)
+			number.floating = node->data.number.value.floating;
+		else
+			number.integer = node->data.number.value.integer;
+		memcpy(flat->data.number.bits, &number, sizeof(number));
+		flat->data.number.isFloat = node->data.number.isFloat;
+	} break;
+	case NODE_STRING: {
+		uint32_t string = (uint32_t)b->string++;
+		size_t length = node->data.string.length;
+		memcpy(b->chars, node->data.string.start, length);
+		ast->strings[string].start = b->chars;
+		ast->strings[string].length = length;
+		ast->strings[string].literal = NULL;
+		b->chars += length;
+		flat->data.string = string;
+	} break;
+	case NODE_BOOLEAN:
+		flat->data.boolean = node->data.boolean.value;
+		break;
+	case NODE_IDENTIFIER: {
+		flat->data.identifier.symbol = node->data.identifier.symbol;
+		flat->data.identifier.depth = node->data.identifier.depth;
+		flat->data.identifier.slot = (uint32_t)node->data.identifier.slot;
+	} break;
+	case NODE_BINARYOP:
+	case NODE_LOGICAL: {
+		flat->op = (uint8_t)node->data.binaryOp.op;
+		flat->data.binaryOp.left = flatChild(b, node->data.binaryOp.left);
+		flat->data.binaryOp.right = flatChild(b, node->data.binaryOp.right);
+	} break;
+	case NODE_CONDITIONAL: {
+		flat->data.ifStatement.condition =
+		    flatChild(b, node->data.conditional.condition);
+		flat->data.ifStatement.thenBranch =
+		    flatChild(b, node->data.conditional.thenExpression);
+		flat->data.ifStatement.elseBranch =
+		    flatChild(b, node->data.conditional.elseExpression);
+	} break;
+	case NODE_UNARYOP: {
+		flat->op = (uint8_t)node->data.unaryOp.op;
+		flat->data.operand = flatChild(b, node->data.unaryOp.operand);
+	} break;
+	case NODE_ASSIGNMENT: {
+		flat->data.assignment.target =
+		    flatChild(b, node->data.assigment.target);
+		flat->data.assignment.value = flatChild(b, node->data.assigment.value);
+	} break;
+	case NODE_CALL: {
+		flat->data.call.argc = (uint32_t)node->data.call.argc;
+		flat->data.call.callee = flatChild(b, node->data.call.callee);
+		flat->data.call.args =
+		    flatList(b, node->data.call.args, node->data.call.argc);
+	} break;
+	default:
+		break;
+	}
+
+	return index;
+}
+
+// Cria a ast compacta de um programa já resolvido
+// Não depende mais da ast original, que pode ser destruída
+FlatAst *flatCreate(AstNode *program) {
+	if (!program || program->type != NODE_PROGRAM)
+		return NULL;
+
+	FlatCount count = {0};
+	count.nodes = 1; // Índice 0 reservado
+	flatCount(program, &count);
+	if (count.nodes > UINT32_MAX || count.lists > UINT32_MAX) {
+		logger(LOG_ERROR, "Internal error: Program too large\n");
+		return NULL;
+	}
+
+	Arena *arena = arenaCreate(64 * 1024);
+	if (!arena) {
+		logger(LOG_ERROR, "Internal error: Failed to create flat ast\n");
+		return NULL;
+	}
+
+	FlatAst *ast = (FlatAst *)arenaAlloc(arena, sizeof(FlatAst));
+	if (!ast) {
+		arenaDestroy(arena);
+		logger(LOG_ERROR, "Internal error: Failed to create flat ast\n");
+		return NULL;
+	}
+	memset(ast, 0, sizeof(FlatAst));
+	ast->arena = arena;
+	ast->count = count.nodes;
+	ast->slotCount = program->data.program.slotCount;
+
+	// Tabelas vazias ainda recebem um endereço válido
+	ast->nodes = arenaAlloc(arena, count.nodes * sizeof(FlatNode));
+	ast->tokens = arenaAlloc(arena, count.nodes * sizeof(uint32_t));
+	ast->lists = arenaAlloc(arena, (count.lists + 1) * sizeof(NodeIndex));
+	ast->functions =
+	    arenaAlloc(arena, (count.functions + 1) * sizeof(FlatFunction));
+	ast->strings = arenaAlloc(arena, (count.strings + 1) * sizeof(FlatString));
+	char *chars = arenaAlloc(arena, count.chars + 1);
+	if (!ast->nodes || !ast->tokens || !ast->lists || !ast->functions ||
+	    !ast->strings || !chars) {
+		arenaDestroy(arena);
+		logger(LOG_ERROR, "Internal error: Failed to create flat ast\n");
+		return NULL;
+	}
+
+	memset(&ast->nodes[NODE_INDEX_NONE], 0, sizeof(FlatNode));
+	ast->tokens[NODE_INDEX_NONE] = 0;
+
+	FlatBuilder builder = {0};
+	builder.ast = ast;
+	builder.node = 1;
+	builder.chars = chars;
+	ast->root = flatNode(&builder, program);
+	if (builder.failed) {
+		arenaDestroy(arena);
+		logger(LOG_ERROR, "Internal error: Missing child in ast\n");
+		return NULL;
+	}
+	return ast;
+}
+
+// Destrói a ast compacta
+void flatDestroy(FlatAst *ast) {
+	if (!ast)
+		return;
+	arenaDestroy(ast->arena);
+}
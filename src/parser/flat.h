@@ -0,0 +1,169 @@
+/**
+ * flat.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../eval/arena.h"
+#include "../lexer/token.h"
+#include "ast.h"
+
+// Ast compacta que o eval percorre
+// Os nós ficam num array só, em pré-ordem, e apontam os filhos por índice
+// Dados frios (tokens, funções, strings, números) ficam em tabelas à parte
+
+struct String;
+
+typedef uint32_t NodeIndex;
+
+// O índice 0 não é de nenhum nó, marca filho ausente
+#define NODE_INDEX_NONE 0
+
+// Feedback de tipos que o eval junta para especializar um nó
+typedef struct {
+	uint8_t seen;   // Par de tipos da última execução
+	uint8_t hits;   // Execuções seguidas com esse par
+	uint8_t deopts; // Vezes que a especialização falhou
+} TypeFeedback;
+
+// Nó de 16 bytes
+typedef struct {
+	uint8_t type; // NodeType
+	uint8_t op;   // TokenType do operador
+
+	union {
+		// NODE_PROGRAM, NODE_BLOCK_STATEMENT
+		struct {
+			uint32_t first; // Início em lists
+			uint32_t count;
+		} list;
+
+		// NODE_EXPRESSION_STATEMENT, NODE_RETURN_STATEMENT, NODE_UNARYOP
+		// NODE_RETURN_TAIL_CALL: expression statement com a chamada
+		NodeIndex operand;
+
+		// NODE_IF_STATEMENT, NODE_CONDITIONAL
+		struct {
+			NodeIndex condition;
+			NodeIndex thenBranch;
+			NodeIndex elseBranch; // NODE_INDEX_NONE se não tiver
+		} ifStatement;
+
+		// NODE_VAR_STATEMENT
+		struct {
+			NodeIndex identifier;
+			NodeIndex expression;
+		} varStatement;
+
+		// NODE_FN_STATEMENT: índice em functions
+		uint32_t function;
+
+		// NODE_WHILE_STATEMENT
+		struct {
+			NodeIndex condition;
+			NodeIndex statement;
+		} whileStatement;
+
+		// NODE_FOR_STATEMENT
+		// Não cabe no nó: identifier, start, end e statement ficam em lists
+		struct {
+			uint32_t parts; // Início em lists
+		} forStatement;
+
+		// NODE_NUMBER
+		// O valor fica em dois words para o nó não precisar de alinhamento 8,
+		// mas cai alinhado no offset 8 do nó
+		struct {
+			uint16_t isFloat;
+			uint16_t cached;  // bits já guarda o Value pronto (VUL_NANBOX)
+			uint32_t bits[2]; // TokenNumber
+		} number;
+
+		// NODE_STRING: índice em strings
+		uint32_t string;
+
+		// NODE_BOOLEAN
+		bool boolean;
+
+		// NODE_IDENTIFIER
+		struct {
+			Symbol symbol;
+			int32_t depth; // Distância em funções ou RESOLVE_*
+			uint32_t slot;
+		} identifier;
+
+		// NODE_BINARYOP, NODE_LOGICAL (sem feedback)
+		struct {
+			NodeIndex left;
+			NodeIndex right;
+			TypeFeedback feedback;
+		} binaryOp;
+
+		// NODE_ASSIGNMENT
+		struct {
+			NodeIndex target;
+			NodeIndex value;
+		} assignment;
+
+		// NODE_CALL
+		struct {
+			NodeIndex callee;
+			uint32_t args; // Início em lists
+			uint32_t argc;
+		} call;
+	} data;
+} FlatNode;
+
+// Definição de função, é para ela que o Value da função aponta
+typedef struct FlatFunction {
+	NodeIndex name; // NODE_IDENTIFIER
+	NodeIndex statement;
+	uint32_t params; // Início em lists
+	uint32_t paramCount;
+	uint32_t slotCount; // Params + locais
+	bool hasClosure;    // Tem funções internas que capturam o env
+} FlatFunction;
+
+// Literal de string, com os bytes copiados para chars
+typedef struct {
+	const char *start;
+	size_t length;
+	struct String *literal; // Criada na primeira execução
+} FlatString;
+
+// Ast compacta, tudo numa arena e liberado de uma vez
+typedef struct {
+	FlatNode *nodes;
+	size_t count;
+	NodeIndex root;     // NODE_PROGRAM
+	size_t slotCount;   // Globais
+	NodeIndex *lists;   // Filhos de blocos, args e params
+	FlatFunction *functions;
+	FlatString *strings;
+
+	// Frio: só as mensagens de erro usam
+	const TokenArray *tokenArray;
+	uint32_t *tokens; // Índice do token de cada nó
+
+	Arena *arena;
+} FlatAst;
+
+FlatAst *flatCreate(AstNode *program);
+void flatDestroy(FlatAst *ast);
+
+// Valor de um NODE_NUMBER
+static inline TokenNumber flatNumber(const FlatNode *node) {
+	TokenNumber number;
+	memcpy(&number, node->data.number.bits, sizeof(number));
+	return number;
+}
+
+// Token de um nó, para mensagens de erro
+static inline Token flatToken(const FlatAst *ast, const FlatNode *node) {
+	return (Token){ast->tokenArray, ast->tokens[node - ast->nodes]};
+}
@@ -18,50 +18,25 @@
 // Helpers
 
 // Retorna true se está no ultimo token da lista
-static bool atEnd(Parser *p) { return (p->pos >= p->tokens.count); }
+static bool atEnd(Parser *p) { return (p->pos >= p->tokens->count); }
 
 // Retorna o token atual
-static Token *peek(Parser *p) {
-	if (!p)
-		return NULL;
-	if (!p->tokens.data)
-		return NULL;
-	if (p->pos > p->tokens.count)
-		return NULL;
-
-	return &p->tokens.data[p->pos];
+// No fim da lista retorna o último token, para as mensagens de erro
+static Token peek(Parser *p) {
+	size_t pos = atEnd(p) ? p->tokens->count - 1 : p->pos;
+	return tokenAt(p->tokens, pos);
 }
 
-// Avança ponteiro de tokens e retorna o token novo
-static Token *advance(Parser *p) {
-	if (!p)
-		return NULL;
-	if (!p->tokens.data)
-		return NULL;
-	if (atEnd(p))
-		return NULL;
-
-	return &p->tokens.data[++p->pos];
+// Avança ponteiro de tokens
+static void advance(Parser *p) {
+	if (!atEnd(p))
+		p->pos++;
 }
 
-// Retorna o token anterior se ele existir
-// static Token *previous(Parser *p) {
-//	if (!p)
-//		return NULL;
-//	if (!p->tokens.data)
-//		return NULL;
-//	if (p->pos == 0)
-//		return NULL;
-//
-//	return &p->tokens.data[p->pos - 1];
-//}
-
 // Verifica se o tipo do token atual bate sem avançar o ponteiro
+// Só lê o array de tipos
 static bool check(Parser *p, TokenType type) {
-	Token *t = peek(p);
-	if (!t)
-		return false;
-	return t->type == type;
+	return !atEnd(p) && p->tokens->types[p->pos] == type;
 }
 
 // Verifica se o tipo do atual bate, se bater, avança o ponteiro
@@ -74,21 +49,116 @@ static bool match(Parser *p, TokenType type) {
 	return false;
 }
 
+// Empilha um nó na lista em construção
+static bool scratchPush(Parser *p, AstNode *node) {
+	if (!node)
+		return false;
+
+	if (p->scratchCount >= p->scratchCapacity) {
+		size_t capacity = p->scratchCapacity ? p->scratchCapacity * 2 : 64;
+		AstNode **scratch =
+		    (AstNode **)realloc(p->scratch, capacity * sizeof(AstNode *));
+		if (!scratch) {
+			logger(LOG_ERROR, "Internal error: Failed to grow node list\n");
+			return false;
+		}
+		p->scratch = scratch;
+		p->scratchCapacity = capacity;
+	}
+
+	p->scratch[p->scratchCount++] = node;
+	return true;
+}
+
+// Fecha a lista que começou em base, copiando para a arena
+static AstNode **scratchFinish(Parser *p, size_t base, size_t *count) {
+	*count = p->scratchCount - base;
+	AstNode **list = astProgramList(p->program, p->scratch + base, *count);
+	p->scratchCount = base;
+	return list;
+}
+
+// Decodifica os escapes de um literal em out
+// out precisa de length bytes, o resultado nunca é maior
+// Retorna o tamanho decodificado
+static size_t decodeEscapes(const char *start, size_t length, char *out) {
+	size_t j = 0;
+	for (size_t i = 0; i < length; i++) {
+		if (start[i] == '\\' && i + 1 < length) {
+			i++;
+			switch (start[i]) {
+			case 'n':
+				out[j++] = '\n';
+				break;
+			case 't':
+				out[j++] = '\t';
+				break;
+			case 'r':
+				out[j++] = '\r';
+				break;
+			default:
+				out[j++] = start[i];
+				break; // escapa qualquer outro, inclusive \\ e \"
+			}
+		} else {
+			out[j++] = start[i];
+		}
+	}
+
+	return j;
+}
+
+// Força de ligação dos operadores, maior liga mais forte
+typedef enum {
+	PRECEDENCE_NONE = 0, // Não continua uma expressão
+	PRECEDENCE_ASSIGNMENT,
+	PRECEDENCE_CONDITIONAL,
+	PRECEDENCE_LOGICAL_OR,
+	PRECEDENCE_LOGICAL_AND,
+	PRECEDENCE_BITWISE_OR,
+	PRECEDENCE_BITWISE_XOR,
+	PRECEDENCE_BITWISE_AND,
+	PRECEDENCE_EQUALITY,
+	PRECEDENCE_COMPARISON,
+	PRECEDENCE_SHIFT,
+	PRECEDENCE_ADITION,
+	PRECEDENCE_MULTIPLICATION,
+	PRECEDENCE_UNARY,
+	PRECEDENCE_CALL
+} Precedence;
+
+// Precedência de cada token que aparece depois de um operando
+static const uint8_t precedences[TOKEN_COUNT] = {
+    [TOKEN_ASSIGN] = PRECEDENCE_ASSIGNMENT,
+    [TOKEN_QUESTION] = PRECEDENCE_CONDITIONAL,
+    [TOKEN_OR] = PRECEDENCE_LOGICAL_OR,
+    [TOKEN_AND] = PRECEDENCE_LOGICAL_AND,
+    [TOKEN_BIT_OR] = PRECEDENCE_BITWISE_OR,
+    [TOKEN_BIT_XOR] = PRECEDENCE_BITWISE_XOR,
+    [TOKEN_BIT_AND] = PRECEDENCE_BITWISE_AND,
+    [TOKEN_EQ] = PRECEDENCE_EQUALITY,
+    [TOKEN_NEQ] = PRECEDENCE_EQUALITY,
+    [TOKEN_LT] = PRECEDENCE_COMPARISON,
+    [TOKEN_GT] = PRECEDENCE_COMPARISON,
+    [TOKEN_LTE] = PRECEDENCE_COMPARISON,
+    [TOKEN_GTE] = PRECEDENCE_COMPARISON,
+    [TOKEN_SHIFT_LEFT] = PRECEDENCE_SHIFT,
+    [TOKEN_SHIFT_RIGHT] = PRECEDENCE_SHIFT,
+    [TOKEN_PLUS] = PRECEDENCE_ADITION,
+    [TOKEN_MINUS] = PRECEDENCE_ADITION,
+    [TOKEN_STAR] = PRECEDENCE_MULTIPLICATION,
+    [TOKEN_SLASH] = PRECEDENCE_MULTIPLICATION,
+    [TOKEN_PERCENT] = PRECEDENCE_MULTIPLICATION,
+    [TOKEN_LPAREN] = PRECEDENCE_CALL,
+};
+
 AstNode *parseLiteral(Parser *p);
 AstNode *parsePrimary(Parser *p);
-AstNode *parseCall(Parser *p);
+AstNode *parseCall(Parser *p, AstNode *callee);
 AstNode *parseUnary(Parser *p);
-AstNode *parseMultiplication(Parser *p);
-AstNode *parseAdition(Parser *p);
-AstNode *parseShift(Parser *p);
-AstNode *parseComparison(Parser *p);
-AstNode *parseEquality(Parser *p);
-AstNode *parseBitwiseAnd(Parser *p);
-AstNode *parseBitwiseXor(Parser *p);
-AstNode *parseBitwiseOr(Parser *p);
-AstNode *parseLogicalAnd(Parser *p);
-AstNode *parseLogicalOr(Parser *p);
-AstNode *parseAssignment(Parser *p);
+AstNode *parseAssignment(Parser *p, AstNode *target, Token firstToken);
+AstNode *parseConditional(Parser *p, AstNode *condition);
+AstNode *parsePrecedence(Parser *p, Precedence minimum);
 AstNode *parseExpression(Parser *p);
 
 AstNode *parseExpressionStatement(Parser *p);
@@ -97,6 +167,7 @@ AstNode *parseIfStatement(Parser *p);
 AstNode *parseReturnStatement(Parser *p);
 AstNode *parseFnStatement(Parser *p);
 AstNode *parseWhileStatement(Parser *p);
+AstNode *parseForStatement(Parser *p);
 
 AstNode *parseStatement(Parser *p);
 
@@ -109,13 +180,13 @@ bool parserValidate(Parser *p) {
 	}
 
 	// Tokens NULL
-	if (!p->tokens.data) {
+	if (!p->tokens || !p->tokens->types) {
 		logger(LOG_ERROR, "Parser error: tokens is NULL\n");
 		return false;
 	}
 
 	// Nenhum token
-	if (p->tokens.count == 0) {
+	if (p->tokens->count == 0) {
 		logger(LOG_ERROR, "Parser error: no have tokens\n");
 		return false;
 	}
@@ -124,16 +195,21 @@ bool parserValidate(Parser *p) {
 }
 
 // Cria um parser
-Parser *parserCreate(TokenArray tokens) {
-	Parser *p = (Parser *)malloc(sizeof(Parser));
-	if (!p)
+// Os tokens precisam viver enquanto a AST existir
+Parser *parserCreate(TokenArray *tokens) {
+	if (!tokens || !tokens->types || tokens->count == 0)
 		return NULL;
 
-	if (!tokens.data || tokens.count == 0)
+	Parser *p = (Parser *)malloc(sizeof(Parser));
+	if (!p)
 		return NULL;
 
 	p->tokens = tokens;
 	p->pos = 0;
+	p->program = NULL;
+	p->scratch = NULL;
+	p->scratchCount = 0;
+	p->scratchCapacity = 0;
 
 	return p;
 }
@@ -148,14 +224,21 @@ AstNode *parserParse(Parser *p) {
 	AstNode *root = astProgramCreate();
 	if (!root)
 		return NULL;
+	p->program = root;
 
 	// Começar parsing
+	// Um erro de sintaxe invalida o programa inteiro, nada é executado
+	size_t base = p->scratchCount;
 	while (!atEnd(p)) {
 		AstNode *statement = parseStatement(p);
-		if (!statement)
-			break;
-		astProgramPush(root, statement);
+		if (!scratchPush(p, statement)) {
+			p->scratchCount = base;
+			astDestroy(root);
+			return NULL;
+		}
 	}
+	root->data.program.statements =
+	    scratchFinish(p, base, &root->data.program.count);
 
 	return root;
 }
@@ -167,6 +250,7 @@ void parserDestroy(Parser *p) {
 		return;
 	}
 
+	free(p->scratch);
 	free(p);
 }
 
@@ -174,82 +258,69 @@ void parserDestroy(Parser *p) {
 AstNode *parseLiteral(Parser *p) {
 	// Number
 	if (check(p, TOKEN_NUMBER_INTEGER) || check(p, TOKEN_NUMBER_FLOAT)) {
-		Token *t = peek(p);
+		Token t = peek(p);
 		advance(p);
 
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = t;
+		AstNode *node = astNodeCreate(p->program, NODE_NUMBER, t);
 		if (!node)
 			return NULL;
 
-		char *end;
-		if (t->type == TOKEN_NUMBER_INTEGER) {
-			long long value = strtoll(t->start, &end, 0);
-			if (end == t->start) {
-				free(node);
-				return NULL;
-			}
-
-			node->type = NODE_NUMBER;
-			node->data.number.value.integer = value;
+		// O lexer já decodificou o valor
+		TokenNumber number = tokenNumber(t);
+		if (tokenType(t) == TOKEN_NUMBER_INTEGER) {
+			node->data.number.value.integer = number.integer;
 			node->data.number.isFloat = false;
-			return node;
 		} else {
-			double value = strtod(t->start, &end);
-			if (end == t->start) {
-				free(node);
-				return NULL;
-			}
-
-			node->type = NODE_NUMBER;
-			node->data.number.value.floating = value;
+			node->data.number.value.floating = number.floating;
 			node->data.number.isFloat = true;
-			return node;
 		}
+		return node;
 	}
 
 	// String
 	if (check(p, TOKEN_STRING)) {
-		Token *t = peek(p);
+		Token t = peek(p);
 		advance(p);
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = t;
+		AstNode *node = astNodeCreate(p->program, NODE_STRING, t);
 		if (!node)
 			return NULL;
 
-		node->type = NODE_STRING;
-		node->data.string.start = t->start;
-		node->data.string.length = t->length;
+		// Sem escapes o literal aponta direto para o código fonte
+		const char *start = tokenStart(t);
+		size_t length = tokenLength(t);
+		if (memchr(start, '\\', length)) {
+			char *decoded = astProgramString(p->program, length);
+			if (!decoded)
+				return NULL;
+			length = decodeEscapes(start, length, decoded);
+			start = decoded;
+		}
+
+		node->data.string.start = start;
+		node->data.string.length = length;
+		node->data.string.literal = NULL;
 		return node;
 	}
 
 	// Boleano
 	if (check(p, TOKEN_KEYWORD_TRUE) || check(p, TOKEN_KEYWORD_FALSE)) {
-		Token *t = peek(p);
+		Token t = peek(p);
 		advance(p);
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = t;
+		AstNode *node = astNodeCreate(p->program, NODE_BOOLEAN, t);
 		if (!node)
 			return NULL;
 
-		node->type = NODE_BOOLEAN;
 		node->data.boolean.value =
-		    t->type == TOKEN_KEYWORD_FALSE ? false : true;
+		    tokenType(t) == TOKEN_KEYWORD_FALSE ? false : true;
 		return node;
 	}
 
 	// Null
 	if (check(p, TOKEN_KEYWORD_NULL)) {
-		Token *t = peek(p);
+		Token t = peek(p);
 		advance(p);
 
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = t;
-		if (!node)
-			return NULL;
-
-		node->type = NODE_NULL;
-		return node;
+		return astNodeCreate(p->program, NODE_NULL, t);
 	}
 
 	return NULL;
@@ -263,7 +334,7 @@ AstNode *parsePrimary(Parser *p) {
 		AstNode *expression = parseExpression(p);
 
 		if (!check(p, TOKEN_RPAREN)) {
-			tokenLogger(LOG_ERROR, *(peek(p)), "Expected ')' after expression");
+			tokenLogger(LOG_ERROR, peek(p), "Expected ')' after expression");
 			return NULL;
 		}
 
@@ -273,17 +344,15 @@ AstNode *parsePrimary(Parser *p) {
 
 	// identifiers
 	if (check(p, TOKEN_IDENTIFIER)) {
-		Token *t = peek(p);
+		Token t = peek(p);
 		advance(p);
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-
+		AstNode *node = astNodeCreate(p->program, NODE_IDENTIFIER, t);
 		if (!node)
 			return NULL;
 
-		node->token = t;
-		node->type = NODE_IDENTIFIER;
-		node->data.identifier.name = t->start;
-		node->data.identifier.length = t->length;
+		node->data.identifier.symbol = tokenSymbol(t);
+		node->data.identifier.depth = RESOLVE_DYNAMIC;
+		node->data.identifier.slot = 0;
 		return node;
 	}
 
@@ -291,424 +360,189 @@ AstNode *parsePrimary(Parser *p) {
 }
 
 // Call
-AstNode *parseCall(Parser *p) {
-	AstNode *left = parsePrimary(p);
-
-	while (match(p, TOKEN_LPAREN)) {
-		AstNode **args = NULL;
-		size_t argc = 0;
-		size_t cap = 0;
-
-		if (!check(p, TOKEN_RPAREN)) { // Parametros
-			do {
-				AstNode *arg = parseExpression(p);
-				if (argc >= cap) {
-					cap = cap ? cap * 2 : 4;
-					args = realloc(args, cap * sizeof(AstNode *));
-				}
-
-				args[argc++] = arg;
-			} while (match(p, TOKEN_COMMA));
-		}
+// callee "(" args ")", o "(" já é o token atual
+AstNode *parseCall(Parser *p, AstNode *callee) {
+	advance(p); // "("
 
-		if (!check(p, TOKEN_RPAREN)) {
-			tokenLogger(LOG_ERROR, *(peek(p)),
-			            "Syntax error: Expected ')' after args");
-			return NULL;
-		}
+	size_t base = p->scratchCount;
+	if (!check(p, TOKEN_RPAREN)) { // Parametros
+		do {
+			AstNode *arg = parseExpression(p);
+			if (!arg || !scratchPush(p, arg)) {
+				p->scratchCount = base;
+				return NULL;
+			}
+		} while (match(p, TOKEN_COMMA));
+	}
 
-		advance(p);
+	if (!check(p, TOKEN_RPAREN)) {
+		tokenLogger(LOG_ERROR, peek(p), "Syntax error: Expected ')' after args");
+		p->scratchCount = base;
+		return NULL;
+	}
 
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		if (!node)
-			return NULL;
-		node->token = left->token;
-		node->type = NODE_CALL;
-		node->data.call.callee = left;
-		node->data.call.args = args;
-		node->data.call.argc = argc;
+	advance(p);
 
-		left = node;
+	AstNode *node = astNodeCreate(p->program, NODE_CALL, callee->token);
+	if (!node) {
+		p->scratchCount = base;
+		return NULL;
 	}
-
-	return left;
+	node->data.call.callee = callee;
+	node->data.call.args = scratchFinish(p, base, &node->data.call.argc);
+	return node;
 }
 
 // Unary
+// ("!" | "~" | "-" | "+") operando, o operador já é o token atual
 AstNode *parseUnary(Parser *p) {
-	if (check(p, TOKEN_NOT) || check(p, TOKEN_BIT_NOT) ||
-	    check(p, TOKEN_MINUS) || check(p, TOKEN_PLUS)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseUnary(p);
-		if (!right)
-			return NULL;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = op;
-		if (!node)
-			return NULL;
-
-		node->type = NODE_UNARYOP;
-		node->data.unaryOp.op = op->type;
-		node->data.unaryOp.operand = right;
-		return node;
-	}
-
-	return parseCall(p);
-}
+	Token op = peek(p);
+	advance(p);
 
-// Multiplication
-AstNode *parseMultiplication(Parser *p) {
-	if (atEnd(p))
+	// O operando só aceita chamadas, que ligam mais forte
+	AstNode *operand = parsePrecedence(p, PRECEDENCE_UNARY);
+	if (!operand)
 		return NULL;
 
-	AstNode *left = parseUnary(p);
-	if (!left)
+	AstNode *node = astNodeCreate(p->program, NODE_UNARYOP, op);
+	if (!node)
 		return NULL;
 
-	while (check(p, TOKEN_STAR) || check(p, TOKEN_SLASH) ||
-	       check(p, TOKEN_PERCENT)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseUnary(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = op;
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
-	}
-
-	return left;
+	node->data.unaryOp.op = tokenType(op);
+	node->data.unaryOp.operand = operand;
+	return node;
 }
 
-// Adition
-AstNode *parseAdition(Parser *p) {
-	if (atEnd(p))
-		return NULL;
+// Assignment
+// Por enquanto:
+// TOKEN_IDENTIFIER "=" expression, associativo à direita
+AstNode *parseAssignment(Parser *p, AstNode *target, Token firstToken) {
+	advance(p); // "="
 
-	AstNode *left = parseMultiplication(p);
-	if (!left)
+	if (target->type != NODE_IDENTIFIER) {
+		tokenLogger(LOG_ERROR, firstToken, "Syntax error: Expected identifier");
 		return NULL;
-
-	while (check(p, TOKEN_PLUS) || check(p, TOKEN_MINUS)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseMultiplication(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = op;
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
 	}
 
-	return left;
-}
-
-// Shift
-AstNode *parseShift(Parser *p) {
-	if (atEnd(p))
+	AstNode *value = parsePrecedence(p, PRECEDENCE_ASSIGNMENT);
+	if (!value)
 		return NULL;
 
-	AstNode *left = parseAdition(p);
-	if (!left)
+	AstNode *node = astNodeCreate(p->program, NODE_ASSIGNMENT, target->token);
+	if (!node)
 		return NULL;
 
-	while (check(p, TOKEN_SHIFT_LEFT) || check(p, TOKEN_SHIFT_RIGHT)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseAdition(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = op;
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
-	}
-
-	return left;
+	node->data.assigment.target = target;
+	node->data.assigment.value = value;
+	return node;
 }
 
-// Comparison
-AstNode *parseComparison(Parser *p) {
-	if (atEnd(p))
-		return NULL;
+// Conditional
+// expression "?" expression ":" expression, associativo à direita
+AstNode *parseConditional(Parser *p, AstNode *condition) {
+	Token question = peek(p);
+	advance(p); // "?"
 
-	AstNode *left = parseShift(p);
-	if (!left)
+	AstNode *thenExpression = parseExpression(p);
+	if (!thenExpression)
 		return NULL;
 
-	while (check(p, TOKEN_LT) || check(p, TOKEN_GT) || check(p, TOKEN_LTE) ||
-	       check(p, TOKEN_GTE)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseShift(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = op;
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
-	}
-
-	return left;
-}
-
-// Equality
-AstNode *parseEquality(Parser *p) {
-	if (atEnd(p))
-		return NULL;
-
-	AstNode *left = parseComparison(p);
-	if (!left)
+	if (!check(p, TOKEN_COLON)) {
+		tokenLogger(LOG_ERROR, peek(p),
+		            "Syntax error: Expected ':' in conditional expression");
 		return NULL;
-
-	while (check(p, TOKEN_EQ) || check(p, TOKEN_NEQ)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseComparison(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = op;
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
 	}
+	advance(p);
 
-	return left;
-}
-
-// Bitwise AND
-AstNode *parseBitwiseAnd(Parser *p) {
-	if (atEnd(p))
+	AstNode *elseExpression = parsePrecedence(p, PRECEDENCE_CONDITIONAL);
+	if (!elseExpression)
 		return NULL;
 
-	AstNode *left = parseEquality(p);
-	if (!left)
+	AstNode *node = astNodeCreate(p->program, NODE_CONDITIONAL, question);
+	if (!node)
 		return NULL;
 
-	while (check(p, TOKEN_BIT_AND)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseEquality(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
-	}
-
-	return left;
+	node->data.conditional.condition = condition;
+	node->data.conditional.thenExpression = thenExpression;
+	node->data.conditional.elseExpression = elseExpression;
+	return node;
 }
 
-// Bitwise XOR
-AstNode *parseBitwiseXor(Parser *p) {
-	if (atEnd(p))
-		return NULL;
-
-	AstNode *left = parseBitwiseAnd(p);
-	if (!left)
-		return NULL;
-
-	while (check(p, TOKEN_BIT_XOR)) {
-		Token *op = peek(p);
-		advance(p);
+// Expressão com operadores de precedência >= minimum (Pratt)
+// Parsea o operando de uma vez e vai subindo pelos operadores da tabela
+// Retorna NULL se faltar um operando, com o erro já reportado
+AstNode *parsePrecedence(Parser *p, Precedence minimum) {
+	Token firstToken = peek(p);
+	size_t start = p->pos;
 
-		AstNode *right = parseBitwiseAnd(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
+	AstNode *left = NULL;
+	if (!atEnd(p)) {
+		TokenType type = tokenType(firstToken);
+		if (type == TOKEN_NOT || type == TOKEN_BIT_NOT ||
+		    type == TOKEN_MINUS || type == TOKEN_PLUS)
+			left = parseUnary(p);
+		else
+			left = parsePrimary(p);
 	}
 
-	return left;
-}
-
-// Bitwise OR
-AstNode *parseBitwiseOr(Parser *p) {
-	if (atEnd(p))
-		return NULL;
-
-	AstNode *left = parseBitwiseXor(p);
-	if (!left)
+	// Nada consumido: não tem expressão aqui
+	// Se consumiu, quem falhou já reportou o erro
+	if (!left) {
+		if (p->pos == start)
+			tokenLogger(LOG_ERROR, peek(p),
+			            "Syntax error: Expected expression");
 		return NULL;
+	}
 
-	while (check(p, TOKEN_BIT_OR)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseBitwiseXor(p);
-		if (!right)
+	while (left && !atEnd(p)) {
+		TokenType type = p->tokens->types[p->pos];
+		Precedence precedence = (Precedence)precedences[type];
+		if (precedence == PRECEDENCE_NONE || precedence < minimum)
 			break;
 
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		if (!node)
-			return NULL;
-
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
-	}
-
-	return left;
-}
+		if (type == TOKEN_LPAREN) {
+			left = parseCall(p, left);
+			continue;
+		}
 
-// Logical AND
-AstNode *parseLogicalAnd(Parser *p) {
-	if (atEnd(p))
-		return NULL;
+		if (type == TOKEN_ASSIGN)
+			return parseAssignment(p, left, firstToken);
 
-	AstNode *left = parseBitwiseOr(p);
-	if (!left)
-		return NULL;
+		if (type == TOKEN_QUESTION) {
+			left = parseConditional(p, left);
+			continue;
+		}
 
-	while (check(p, TOKEN_AND)) {
-		Token *op = peek(p);
+		Token op = peek(p);
 		advance(p);
 
-		AstNode *right = parseBitwiseOr(p);
+		// Associativo à esquerda: o lado direito só pega operadores mais fortes
+		AstNode *right = parsePrecedence(p, precedence + 1);
 		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		if (!node)
 			return NULL;
 
-		node->type = NODE_BINARYOP;
-		node->data.binaryOp.left = left;
-		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
-		left = node;
-	}
+		// and/or viram um nó próprio para o lado direito ser preguiçoso
+		NodeType nodeType = NODE_BINARYOP;
+		if (type == TOKEN_AND || type == TOKEN_OR)
+			nodeType = NODE_LOGICAL;
 
-	return left;
-}
-
-// Logical OR
-AstNode *parseLogicalOr(Parser *p) {
-	if (atEnd(p))
-		return NULL;
-
-	AstNode *left = parseLogicalAnd(p);
-	if (!left)
-		return NULL;
-
-	while (check(p, TOKEN_OR)) {
-		Token *op = peek(p);
-		advance(p);
-
-		AstNode *right = parseLogicalAnd(p);
-		if (!right)
-			break;
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		node->token = op;
+		AstNode *node = astNodeCreate(p->program, nodeType, op);
 		if (!node)
 			return NULL;
 
-		node->type = NODE_BINARYOP;
 		node->data.binaryOp.left = left;
 		node->data.binaryOp.right = right;
-		node->data.binaryOp.op = op->type;
+		node->data.binaryOp.op = tokenType(op);
 		left = node;
 	}
 
 	return left;
 }
 
-// Assignment
-// Por enquanto:
-// TOKEN_IDENTIFIER "="
-AstNode *parseAssignment(Parser *p) {
-	Token *firstToken = peek(p);
-	AstNode *target = parseLogicalOr(p);
-
-	// Se é '=' depois da expressão
-	if (match(p, TOKEN_ASSIGN)) {
-		if (target->type != NODE_IDENTIFIER) {
-			tokenLogger(LOG_ERROR, *firstToken,
-			            "Syntax error: Expected identifier");
-			return NULL;
-		}
-
-		AstNode *value = parseAssignment(p);
-
-		AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-		if (!node)
-			return NULL;
-
-		node->type = NODE_ASSIGNMENT;
-		node->data.assigment.target = target;
-		node->data.assigment.value = value;
-		return node;
-	}
-
-	return target;
-}
-
 // Expression
-AstNode *parseExpression(Parser *p) { return parseAssignment(p); }
+AstNode *parseExpression(Parser *p) {
+	return parsePrecedence(p, PRECEDENCE_ASSIGNMENT);
+}
 
 // Expression statement
 // expression ";"
@@ -719,14 +553,17 @@ AstNode *parseExpressionStatement(Parser *p) {
 	}
 
 	if (!check(p, TOKEN_SEMICOLON)) {
-		tokenLogger(LOG_ERROR, *(peek(p)),
+		tokenLogger(LOG_ERROR, peek(p),
 		            "Syntax error: Expected ';' after expression");
 		return NULL;
 	}
 	advance(p);
 
-	AstNode *statement = (AstNode *)malloc(sizeof(AstNode));
-	statement->type = NODE_EXPRESSION_STATEMENT;
+	AstNode *statement = astNodeCreate(p->program, NODE_EXPRESSION_STATEMENT,
+	                                   expression->token);
+	if (!statement)
+		return NULL;
+
 	statement->data.expressionStatement.expression = expression;
 	return statement;
 }
@@ -736,29 +573,33 @@ AstNode *parseExpressionStatement(Parser *p) {
 AstNode *parseBlockStatement(Parser *p) {
 	if (!check(p, TOKEN_LBRACE)) // "{"
 		return NULL;
-	Token *t = peek(p);
+	Token t = peek(p);
 	advance(p);
 
-	AstNode *block = astBlockCreate();
+	AstNode *block = astNodeCreate(p->program, NODE_BLOCK_STATEMENT, t);
 	if (!block) {
-		tokenLogger(LOG_ERROR, *t, "Failed to create block\n");
+		tokenLogger(LOG_ERROR, t, "Failed to create block\n");
 		return NULL;
 	}
 
-	AstNode *statement = NULL;
-	while (!atEnd(p) && peek(p)->type != TOKEN_RBRACE) { // statement*
-		statement = parseStatement(p);
-		if (!statement)
-			break;
-		astBlockPush(block, statement);
+	size_t base = p->scratchCount;
+	while (!atEnd(p) && !check(p, TOKEN_RBRACE)) { // statement*
+		AstNode *statement = parseStatement(p);
+		if (!scratchPush(p, statement)) {
+			p->scratchCount = base;
+			return NULL;
+		}
 	}
 
 	if (!check(p, TOKEN_RBRACE)) { // "}"
-		tokenLogger(LOG_ERROR, *t, "Syntax error: Unclosed block\n");
+		tokenLogger(LOG_ERROR, t, "Syntax error: Unclosed block\n");
+		p->scratchCount = base;
 		return NULL;
 	}
 	advance(p);
 
+	block->data.blockStatement.statements =
+	    scratchFinish(p, base, &block->data.blockStatement.count);
 	return block;
 }
 
@@ -767,11 +608,11 @@ AstNode *parseBlockStatement(Parser *p) {
 AstNode *parseIfStatement(Parser *p) {
 	if (!check(p, TOKEN_KEYWORD_IF)) // if
 		return NULL;
-	Token *t = peek(p);
+	Token t = peek(p);
 	advance(p);
 
 	if (!check(p, TOKEN_LPAREN)) { // "("
-		tokenLogger(LOG_ERROR, *(peek(p)), "Expected '(' after if");
+		tokenLogger(LOG_ERROR, peek(p), "Expected '(' after if");
 		return NULL;
 	}
 	advance(p);
@@ -781,7 +622,7 @@ AstNode *parseIfStatement(Parser *p) {
 		return NULL;
 
 	if (!check(p, TOKEN_RPAREN)) { // ")"
-		tokenLogger(LOG_ERROR, *(peek(p)), "Expression ')' after expression");
+		tokenLogger(LOG_ERROR, peek(p), "Expression ')' after expression");
 		return NULL;
 	}
 	advance(p);
@@ -798,12 +639,10 @@ AstNode *parseIfStatement(Parser *p) {
 			return NULL;
 	}
 
-	AstNode *node = (AstNode *)malloc(sizeof(AstNode));
+	AstNode *node = astNodeCreate(p->program, NODE_IF_STATEMENT, t);
 	if (!node)
 		return NULL;
 
-	node->type = NODE_IF_STATEMENT;
-	node->token = t;
 	node->data.ifStatement.condition = condition;
 	node->data.ifStatement.thenBranch = thenBranch;
 	node->data.ifStatement.elseBranch = elseBranch;
@@ -816,29 +655,24 @@ AstNode *parseIfStatement(Parser *p) {
 AstNode *parseReturnStatement(Parser *p) {
 	if (!check(p, TOKEN_KEYWORD_RETURN)) // return
 		return NULL;
-	Token *t = peek(p);
+	Token t = peek(p);
 	advance(p);
 
 	AstNode *statement = NULL;
-	if (!match(p, TOKEN_SEMICOLON)) {
+	if (!check(p, TOKEN_SEMICOLON)) {
 		statement = parseStatement(p);
 		if (!statement)
 			return NULL;
 	} else {
-		statement = (AstNode *)malloc(sizeof(AstNode));
-		statement->type = NODE_NULL;
-		statement->token = peek(p);
-
-		if (!check(p, TOKEN_SEMICOLON)) { // Esperar ";"
-			tokenLogger(LOG_ERROR, *(peek(p)),
-			            "Syntax error: Expected ';' after return");
+		statement = astNodeCreate(p->program, NODE_NULL, peek(p));
+		if (!statement)
 			return NULL;
-		}
+		advance(p); // ";"
 	}
 
-	AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-	node->type = NODE_RETURN_STATEMENT;
-	node->token = t;
+	AstNode *node = astNodeCreate(p->program, NODE_RETURN_STATEMENT, t);
+	if (!node)
+		return NULL;
 	node->data.returnStatement.statement = statement;
 
 	return node;
@@ -849,7 +683,7 @@ AstNode *parseReturnStatement(Parser *p) {
 AstNode *parseVarStatement(Parser *p) {
 	if (!check(p, TOKEN_KEYWORD_VAR)) // var
 		return NULL;
-	Token *t = peek(p);
+	Token t = peek(p);
 	advance(p);
 
 	AstNode *identifier = parsePrimary(p); // identifier
@@ -857,14 +691,12 @@ AstNode *parseVarStatement(Parser *p) {
 		return NULL;
 
 	if (identifier->type != NODE_IDENTIFIER) {
-		tokenLogger(LOG_ERROR, *t,
+		tokenLogger(LOG_ERROR, t,
 		            "Syntax error: Expected identifier after var");
 		return NULL;
 	}
 
-	AstNode *expression = (AstNode *)malloc(sizeof(AstNode));
-	if (!expression)
-		return NULL;
+	AstNode *expression = NULL;
 	if (check(p, TOKEN_ASSIGN)) { // Tem expressão?
 		advance(p);               // "="
 
@@ -873,28 +705,27 @@ AstNode *parseVarStatement(Parser *p) {
 			return NULL;
 
 		if (!check(p, TOKEN_SEMICOLON)) { // Esperar ";"
-			tokenLogger(LOG_ERROR, *(peek(p)),
+			tokenLogger(LOG_ERROR, peek(p),
 			            "Syntax error: Expected ';' after expression");
 			return NULL;
 		}
 	} else {
-		expression->type = NODE_NULL;
-		expression->token = t;
+		expression = astNodeCreate(p->program, NODE_NULL, t);
+		if (!expression)
+			return NULL;
 
 		if (!check(p, TOKEN_SEMICOLON)) { // Esperar ";"
-			tokenLogger(LOG_ERROR, *(peek(p)),
+			tokenLogger(LOG_ERROR, peek(p),
 			            "Syntax error: Expected ';' after identifier");
 			return NULL;
 		}
 	}
 	advance(p);
 
-	AstNode *node = (AstNode *)malloc(sizeof(AstNode));
+	AstNode *node = astNodeCreate(p->program, NODE_VAR_STATEMENT, t);
 	if (!node)
 		return NULL;
 
-	node->type = NODE_VAR_STATEMENT;
-	node->token = t;
 	node->data.varStatement.identifier = identifier;
 	node->data.varStatement.expression = expression;
 
@@ -906,88 +737,166 @@ AstNode *parseVarStatement(Parser *p) {
 AstNode *parseFnStatement(Parser *p) {
 	if (!check(p, TOKEN_KEYWORD_FN)) // fn
 		return NULL;
-	Token *t = peek(p);
+	Token t = peek(p);
 	advance(p);
 
 	AstNode *functionName = parsePrimary(p);
 	if (!functionName || functionName->type != NODE_IDENTIFIER)
 		return NULL;
 
-	AstNode **params = NULL;
-	size_t paramCount = 0;
-	size_t cap = 0;
-
 	if (!match(p, TOKEN_LPAREN)) { // "("
-		tokenLogger(LOG_ERROR, *(peek(p)),
+		tokenLogger(LOG_ERROR, peek(p),
 		            "Syntax error: Expected '(' after function name");
 		return NULL;
 	}
 
+	size_t base = p->scratchCount;
 	if (!check(p, TOKEN_RPAREN)) {
 		do {
 			AstNode *param = parsePrimary(p);
-			if (!param)
+			if (!param) {
+				p->scratchCount = base;
 				return NULL;
+			}
 
 			if (param->type != NODE_IDENTIFIER) {
 				tokenLogger(
-				    LOG_ERROR, *(peek(p)),
+				    LOG_ERROR, peek(p),
 				    "Syntax error: The parameter must be an identifier");
+				p->scratchCount = base;
 				return NULL;
 			}
 
-			if (paramCount >= cap) {
-				cap = cap ? cap * 2 : 1;
-				AstNode **newParams =
-				    (AstNode **)realloc(params, cap * sizeof(AstNode *));
-
-				if (!newParams) {
-					logger(LOG_ERROR, "Internal error: Failed to alloc params");
-					free(params);
-					return NULL;
-				}
-				params = newParams;
+			if (!scratchPush(p, param)) {
+				p->scratchCount = base;
+				return NULL;
 			}
-
-			params[paramCount++] = param;
 		} while (match(p, TOKEN_COMMA));
 
 		if (!match(p, TOKEN_RPAREN)) {
-			tokenLogger(LOG_ERROR, *(peek(p)),
+			tokenLogger(LOG_ERROR, peek(p),
 			            "Syntax error: Expected ')' after parameters");
-			free(params);
+			p->scratchCount = base;
 			return NULL;
 		}
 	} else {
 		advance(p);
 	}
 
+	// Fecha os params antes do corpo, que usa a mesma pilha
+	size_t paramCount;
+	AstNode **params = scratchFinish(p, base, &paramCount);
+
 	AstNode *statement = parseStatement(p);
-	if (!statement) {
-		free(params);
+	if (!statement)
 		return NULL;
-	}
 
-	AstNode *node = (AstNode *)malloc(sizeof(AstNode));
-	if (!node) {
-		free(params);
+	AstNode *node = astNodeCreate(p->program, NODE_FN_STATEMENT, t);
+	if (!node)
 		return NULL;
-	}
-	node->token = t;
-	node->type = NODE_FN_STATEMENT;
+
 	node->data.fnStatement.functionName = functionName;
 	node->data.fnStatement.paramCount = paramCount;
 	node->data.fnStatement.params = params;
 	node->data.fnStatement.statement = statement;
+	node->data.fnStatement.slotCount = 0;
+	node->data.fnStatement.hasClosure = false;
 
 	return node;
 }
 
-// While
+// While statement
+// while "(" expression ")" statement
 AstNode *parseWhileStatement(Parser *p) {
-    (void)p;
-    // TODO: implementar
-    return NULL;
+	if (!check(p, TOKEN_KEYWORD_WHILE)) // while
+		return NULL;
+	Token t = peek(p);
+	advance(p);
+
+	if (!check(p, TOKEN_LPAREN)) { // "("
+		tokenLogger(LOG_ERROR, peek(p),
+		            "Syntax error: Expected '(' after while");
+		return NULL;
+	}
+	advance(p);
+
+	AstNode *condition = parseExpression(p); // expression
+	if (!condition)
+		return NULL;
+
+	if (!check(p, TOKEN_RPAREN)) { // ")"
+		tokenLogger(LOG_ERROR, peek(p),
+		            "Syntax error: Expected ')' after expression");
+		return NULL;
+	}
+	advance(p);
+
+	AstNode *statement = parseStatement(p);
+	if (!statement)
+		return NULL;
+
+	AstNode *node = astNodeCreate(p->program, NODE_WHILE_STATEMENT, t);
+	if (!node)
+		return NULL;
+
+	node->data.whileStatement.condition = condition;
+	node->data.whileStatement.statement = statement;
+
+	return node;
+}
+
+// For statement
+// for identifier in expression ".." expression statement
+AstNode *parseForStatement(Parser *p) {
+	if (!check(p, TOKEN_KEYWORD_FOR)) // for
+		return NULL;
+	Token t = peek(p);
+	advance(p);
+
+	AstNode *identifier = parsePrimary(p); // identifier
+	if (!identifier)
+		return NULL;
+
+	if (identifier->type != NODE_IDENTIFIER) {
+		tokenLogger(LOG_ERROR, t,
+		            "Syntax error: Expected identifier after for");
+		return NULL;
+	}
+
+	if (!match(p, TOKEN_KEYWORD_IN)) { // in
+		tokenLogger(LOG_ERROR, peek(p),
+		            "Syntax error: Expected 'in' after identifier");
+		return NULL;
+	}
+
+	AstNode *start = parseExpression(p); // expression
+	if (!start)
+		return NULL;
+
+	if (!match(p, TOKEN_DOT_DOT)) { // ".."
+		tokenLogger(LOG_ERROR, peek(p),
+		            "Syntax error: Expected '..' after range start");
+		return NULL;
+	}
+
+	AstNode *end = parseExpression(p); // expression
+	if (!end)
+		return NULL;
+
+	AstNode *statement = parseStatement(p);
+	if (!statement)
+		return NULL;
+
+	AstNode *node = astNodeCreate(p->program, NODE_FOR_STATEMENT, t);
+	if (!node)
+		return NULL;
+
+	node->data.forStatement.identifier = identifier;
+	node->data.forStatement.start = start;
+	node->data.forStatement.end = end;
+	node->data.forStatement.statement = statement;
+
+	return node;
 }
 
 // Statement
@@ -1013,5 +922,13 @@ AstNode *parseStatement(Parser *p) {
 	          TOKEN_KEYWORD_FN)) // fn: fn identifier "(" params ")" statement
 		return parseFnStatement(p);
 
+	if (check(p, TOKEN_KEYWORD_WHILE)) // while: while "(" expression ")"
+	                                   // statement
+		return parseWhileStatement(p);
+
+	if (check(p, TOKEN_KEYWORD_FOR)) // for: for identifier in expression
+	                                 // ".." expression statement
+		return parseForStatement(p);
+
 	return parseExpressionStatement(p);
 }
@@ -12,11 +12,18 @@
 
 // Parser
 typedef struct {
-	TokenArray tokens;
+	TokenArray *tokens;
 	size_t pos;
+	AstNode *program; // Dono da arena dos nós
+
+	// Pilha de listas em construção (args, params, statements)
+	// Cada lista pronta é copiada para a arena no tamanho exato
+	AstNode **scratch;
+	size_t scratchCount;
+	size_t scratchCapacity;
 } Parser;
 
 bool parserValidate(Parser *p);
-Parser *parserCreate(TokenArray tokens);
+Parser *parserCreate(TokenArray *tokens);
 AstNode *parserParse(Parser *p);
 void parserDestroy(Parser *p);
@@ -0,0 +1,117 @@
+/**
+ * source.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+
+// Mapeia o arquivo só leitura, direto do page cache
+// Reserva uma página anônima a mais para garantir o '\0' no fim
+static bool sourceMap(Source *source, int fd, size_t size) {
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t mapped = (size + 1 + page - 1) & ~(page - 1);
+
+	char *memory =
+	    mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+		return false;
+
+	// O arquivo cobre o começo da reserva, o resto continua zerado
+	if (mmap(memory, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+	    MAP_FAILED) {
+		munmap(memory, mapped);
+		return false;
+	}
+	madvise(memory, size, MADV_SEQUENTIAL);
+
+	source->content = memory;
+	source->size = size;
+	source->mappedSize = mapped;
+	return true;
+}
+
+// Lê o arquivo inteiro para a memória
+// Funciona também para pipes e outros arquivos sem tamanho
+static bool sourceRead(Source *source, int fd) {
+	size_t capacity = 64 * 1024;
+	size_t size = 0;
+	char *content = (char *)malloc(capacity);
+	if (!content)
+		return false;
+
+	for (;;) {
+		if (size + 1 >= capacity) {
+			char *newContent = (char *)realloc(content, capacity * 2);
+			if (!newContent) {
+				free(content);
+				return false;
+			}
+			content = newContent;
+			capacity *= 2;
+		}
+
+		ssize_t count = read(fd, content + size, capacity - size - 1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			free(content);
+			return false;
+		}
+		if (count == 0)
+			break;
+		size += (size_t)count;
+	}
+
+	content[size] = '\0';
+	source->content = content;
+	source->size = size;
+	source->mappedSize = 0;
+	return true;
+}
+
+// Carrega um script
+// Arquivos regulares usam mmap se useMmap, o resto é lido com read
+bool sourceLoad(Source *source, const char *filename, bool useMmap) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		logger(LOG_ERROR, "Failed to open %s: %s\n", filename, strerror(errno));
+		return false;
+	}
+
+	struct stat info;
+	bool loaded = false;
+	if (useMmap && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+	    info.st_size > 0)
+		loaded = sourceMap(source, fd, (size_t)info.st_size);
+	if (!loaded)
+		loaded = sourceRead(source, fd);
+	if (!loaded)
+		logger(LOG_ERROR, "Failed to read file: %s: %s\n", filename,
+		       strerror(errno));
+
+	close(fd); // O mapeamento continua valendo sem o fd
+	return loaded;
+}
+
+// Libera o código fonte
+void sourceDestroy(Source *source) {
+	if (!source || !source->content)
+		return;
+
+	if (source->mappedSize)
+		munmap((void *)source->content, source->mappedSize);
+	else
+		free((void *)source->content);
+	source->content = NULL;
+}
@@ -0,0 +1,20 @@
+/**
+ * source.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+// Código fonte de um script
+// Tokens, identificadores e strings apontam para content, então ele vive
+// até o fim do programa. Sempre tem um '\0' depois do último byte.
+typedef struct {
+	const char *content;
+	size_t size;
+	size_t mappedSize; // 0 se veio do malloc
+} Source;
+
+bool sourceLoad(Source *source, const char *filename, bool useMmap);
+void sourceDestroy(Source *source);
@@ -0,0 +1,123 @@
+/**
+ * symbol.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "symbol.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+typedef struct {
+	const char *name;
+	uint32_t length;
+	uint32_t hash;
+} SymbolEntry;
+
+// Tabela global de símbolos
+// entries é indexado pelo id, slots é um hash aberto de ids
+typedef struct {
+	SymbolEntry *entries;
+	size_t count;
+	size_t capacity;
+	Symbol *slots;
+	size_t slotCapacity; // Sempre potência de 2
+} SymbolTable;
+
+static SymbolTable table = {0};
+
+// FNV-1a
+static uint32_t symbolHash(const char *name, size_t length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Dobra o hash e reinsere os ids
+static bool symbolGrowSlots(void) {
+	size_t capacity = table.slotCapacity ? table.slotCapacity * 2 : 256;
+	Symbol *slots = (Symbol *)calloc(capacity, sizeof(Symbol));
+	if (!slots)
+		return false;
+
+	for (size_t i = 1; i < table.count; i++) {
+		size_t index = table.entries[i].hash & (capacity - 1);
+		while (slots[index] != SYMBOL_NONE)
+			index = (index + 1) & (capacity - 1);
+		slots[index] = (Symbol)i;
+	}
+
+	free(table.slots);
+	table.slots = slots;
+	table.slotCapacity = capacity;
+	return true;
+}
+
+// Retorna o id de um nome, criando se for novo
+Symbol symbolIntern(const char *name, size_t length) {
+	// Mantém o hash no máximo meio cheio
+	if (table.count * 2 >= table.slotCapacity && !symbolGrowSlots()) {
+		logger(LOG_ERROR, "Internal error: Failed to grow symbol table\n");
+		return SYMBOL_NONE;
+	}
+
+	uint32_t hash = symbolHash(name, length);
+	size_t mask = table.slotCapacity - 1;
+	size_t index = hash & mask;
+	while (table.slots[index] != SYMBOL_NONE) {
+		SymbolEntry *entry = &table.entries[table.slots[index]];
+		if (entry->hash == hash && entry->length == length &&
+		    memcmp(entry->name, name, length) == 0)
+			return table.slots[index];
+		index = (index + 1) & mask;
+	}
+
+	// O id 0 fica reservado para SYMBOL_NONE
+	if (table.count == 0)
+		table.count = 1;
+
+	if (table.count >= table.capacity) {
+		size_t capacity = table.capacity ? table.capacity * 2 : 256;
+		SymbolEntry *entries = (SymbolEntry *)realloc(
+		    table.entries, capacity * sizeof(SymbolEntry));
+		if (!entries) {
+			logger(LOG_ERROR, "Internal error: Failed to grow symbol table\n");
+			return SYMBOL_NONE;
+		}
+		table.entries = entries;
+		table.capacity = capacity;
+	}
+
+	Symbol symbol = (Symbol)table.count++;
+	table.entries[symbol].name = name;
+	table.entries[symbol].length = (uint32_t)length;
+	table.entries[symbol].hash = hash;
+	table.slots[index] = symbol;
+	return symbol;
+}
+
+// Nome de um símbolo, sem '\0' no fim
+const char *symbolName(Symbol symbol) {
+	if (symbol == SYMBOL_NONE || symbol >= table.count)
+		return "";
+	return table.entries[symbol].name;
+}
+
+size_t symbolLength(Symbol symbol) {
+	if (symbol == SYMBOL_NONE || symbol >= table.count)
+		return 0;
+	return table.entries[symbol].length;
+}
+
+// Libera a tabela
+void symbolDestroy(void) {
+	free(table.entries);
+	free(table.slots);
+	table = (SymbolTable){0};
+}
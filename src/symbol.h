@@ -0,0 +1,22 @@
+/**
+ * symbol.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Símbolo: id de um nome na tabela global
+// Nomes iguais têm o mesmo id, então comparar nomes é comparar inteiros
+typedef uint32_t Symbol;
+
+// Id 0 não é de nenhum nome, marca slot vazio
+#define SYMBOL_NONE 0
+
+// O nome não é copiado, precisa viver enquanto a tabela existir
+// (código fonte ou string estática)
+Symbol symbolIntern(const char *name, size_t length);
+const char *symbolName(Symbol symbol);
+size_t symbolLength(Symbol symbol);
+void symbolDestroy(void);
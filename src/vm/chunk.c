@@ -0,0 +1,198 @@
+/**
+ * chunk.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "chunk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util.h"
+
+#define INDENT(d)                                                              \
+	for (int i = 0; i < (d); i++)                                              \
+		printf(" ");
+
+static const char *opNames[] = {
+    [OP_MOVE] = "MOVE",         [OP_LOADK] = "LOADK",
+    [OP_LOADI] = "LOADI",       [OP_LOADNULL] = "LOADNULL",
+    [OP_LOADBOOL] = "LOADBOOL", [OP_GETGLOBAL] = "GETGLOBAL",
+    [OP_SETGLOBAL] = "SETGLOBAL", [OP_DEFGLOBAL] = "DEFGLOBAL",
+    [OP_GETLOCAL] = "GETLOCAL", [OP_SETLOCAL] = "SETLOCAL",
+    [OP_GETUPVAL] = "GETUPVAL", [OP_SETUPVAL] = "SETUPVAL",
+    [OP_GETCELL] = "GETCELL",   [OP_SETCELL] = "SETCELL",
+    [OP_BOX] = "BOX",           [OP_CLOSURE] = "CLOSURE",
+    [OP_ADD] = "ADD",           [OP_SUB] = "SUB",
+    [OP_MUL] = "MUL",           [OP_DIV] = "DIV",
+    [OP_MOD] = "MOD",           [OP_SHL] = "SHL",
+    [OP_SHR] = "SHR",           [OP_BAND] = "BAND",
+    [OP_BOR] = "BOR",           [OP_BXOR] = "BXOR",
+    [OP_EQ] = "EQ",             [OP_NEQ] = "NEQ",
+    [OP_LT] = "LT",             [OP_GT] = "GT",
+    [OP_LTE] = "LTE",           [OP_GTE] = "GTE",
+    [OP_NEGATE] = "NEGATE",     [OP_POSITIVE] = "POSITIVE",
+    [OP_BIT_NOT] = "BIT_NOT",   [OP_NOT] = "NOT",
+    [OP_JMP] = "JMP",           [OP_JMPIF] = "JMPIF",
+    [OP_JMPIFNOT] = "JMPIFNOT", [OP_LOOP] = "LOOP",
+    [OP_FORPREP] = "FORPREP",   [OP_FORLOOP] = "FORLOOP",
+    [OP_CALL] = "CALL",         [OP_TAILCALL] = "TAILCALL",
+    [OP_RETURN] = "RETURN",     [OP_RETURNNULL] = "RETURNNULL",
+};
+
+// Cria um chunk vazio
+Chunk *chunkCreate(const char *name, size_t nameLength) {
+	Chunk *chunk = (Chunk *)calloc(1, sizeof(Chunk));
+	if (!chunk)
+		return NULL;
+
+	chunk->name = name;
+	chunk->nameLength = nameLength;
+	return chunk;
+}
+
+// Adiciona uma instrução no chunk
+// Retorna o índice da instrução
+size_t chunkEmit(Chunk *chunk, uint32_t instruction, Token token) {
+	if (chunk->count >= chunk->capacity) {
+		size_t newCapacity = chunk->capacity ? chunk->capacity * 2 : 64;
+		uint32_t *newCode =
+		    (uint32_t *)realloc(chunk->code, newCapacity * sizeof(uint32_t));
+		if (!newCode) {
+			logger(LOG_ERROR, "Internal error: Failed to grow chunk code\n");
+			return chunk->count;
+		}
+		chunk->code = newCode;
+
+		Token *newTokens =
+		    (Token *)realloc(chunk->tokens, newCapacity * sizeof(Token));
+		if (!newTokens) {
+			logger(LOG_ERROR, "Internal error: Failed to grow chunk code\n");
+			return chunk->count;
+		}
+		chunk->tokens = newTokens;
+		chunk->capacity = newCapacity;
+	}
+
+	chunk->code[chunk->count] = instruction;
+	chunk->tokens[chunk->count] = token;
+	return chunk->count++;
+}
+
+// Retorna true se duas constantes são iguais
+static bool constantEquals(Value a, Value b) {
+	if (VALUE_TYPE(a) != VALUE_TYPE(b))
+		return false;
+
+	switch (VALUE_TYPE(a)) {
+	case VALUE_INTEGER:
+		return AS_INTEGER(a) == AS_INTEGER(b);
+	case VALUE_FLOATING: {
+		double x = AS_FLOATING(a);
+		double y = AS_FLOATING(b);
+		return memcmp(&x, &y, sizeof(double)) == 0;
+	}
+	case VALUE_STRING:
+		return AS_STRING(a) == AS_STRING(b);
+	default:
+		return false;
+	}
+}
+
+// Adiciona uma constante no chunk, reaproveitando iguais
+// Retorna o índice da constante
+size_t chunkAddConstant(Chunk *chunk, Value value) {
+	for (size_t i = 0; i < chunk->constantCount; i++) {
+		if (constantEquals(chunk->constants[i], value))
+			return i;
+	}
+
+	if (chunk->constantCount >= chunk->constantCapacity) {
+		size_t newCapacity =
+		    chunk->constantCapacity ? chunk->constantCapacity * 2 : 8;
+		Value *newConstants =
+		    (Value *)realloc(chunk->constants, newCapacity * sizeof(Value));
+		if (!newConstants) {
+			logger(LOG_ERROR, "Internal error: Failed to grow constants\n");
+			return chunk->constantCount;
+		}
+		chunk->constants = newConstants;
+		chunk->constantCapacity = newCapacity;
+	}
+
+	chunk->constants[chunk->constantCount] = value;
+	return chunk->constantCount++;
+}
+
+// Adiciona uma função filha no chunk
+// Retorna o índice do filho
+size_t chunkAddChild(Chunk *chunk, Chunk *child) {
+	if (chunk->childCount >= chunk->childCapacity) {
+		size_t newCapacity = chunk->childCapacity ? chunk->childCapacity * 2 : 4;
+		Chunk **newChildren =
+		    (Chunk **)realloc(chunk->children, newCapacity * sizeof(Chunk *));
+		if (!newChildren) {
+			logger(LOG_ERROR, "Internal error: Failed to grow children\n");
+			return chunk->childCount;
+		}
+		chunk->children = newChildren;
+		chunk->childCapacity = newCapacity;
+	}
+
+	chunk->children[chunk->childCount] = child;
+	return chunk->childCount++;
+}
+
+// Adiciona um upvalue no chunk
+bool chunkAddUpvalue(Chunk *chunk, UpvalueInfo upvalue) {
+	UpvalueInfo *newUpvalues = (UpvalueInfo *)realloc(
+	    chunk->upvalues, (chunk->upvalueCount + 1) * sizeof(UpvalueInfo));
+	if (!newUpvalues)
+		return false;
+
+	chunk->upvalues = newUpvalues;
+	chunk->upvalues[chunk->upvalueCount++] = upvalue;
+	return true;
+}
+
+// Imprime o bytecode de um chunk e dos filhos
+void chunkDump(Chunk *chunk, int depth) {
+	if (!chunk)
+		return;
+
+	INDENT(depth);
+	printf("CHUNK %.*s: params=%zu, registers=%zu, upvalues=%zu\n",
+	       (int)chunk->nameLength, chunk->name, chunk->paramCount,
+	       chunk->registerCount, chunk->upvalueCount);
+
+	for (size_t i = 0; i < chunk->count; i++) {
+		uint32_t instruction = chunk->code[i];
+		OpCode op = INSTRUCTION_OP(instruction);
+
+		INDENT(depth + 1);
+		printf("%04zu %-10s A=%u B=%u C=%u Bx=%u sBx=%d\n", i, opNames[op],
+		       INSTRUCTION_A(instruction), INSTRUCTION_B(instruction),
+		       INSTRUCTION_C(instruction), INSTRUCTION_BX(instruction),
+		       INSTRUCTION_SBX(instruction));
+	}
+
+	for (size_t i = 0; i < chunk->childCount; i++)
+		chunkDump(chunk->children[i], depth + 2);
+}
+
+// Destrói um chunk e seus filhos
+void chunkDestroy(Chunk *chunk) {
+	if (!chunk)
+		return;
+
+	for (size_t i = 0; i < chunk->childCount; i++)
+		chunkDestroy(chunk->children[i]);
+
+	free(chunk->code);
+	free(chunk->tokens);
+	free(chunk->constants);
+	free(chunk->children);
+	free(chunk->upvalues);
+	free(chunk);
+}
@@ -0,0 +1,129 @@
+/**
+ * chunk.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../eval/value.h"
+#include "../lexer/token.h"
+
+// Instruções de 32 bits
+// ABC: | op:8 | A:8 | B:8 | C:8 |
+// ABx: | op:8 | A:8 | Bx:16 |
+// sBx é Bx com bias, usado para saltos
+#define INSTRUCTION_OP(i) ((OpCode)((i) & 0xFF))
+#define INSTRUCTION_A(i) (((i) >> 8) & 0xFF)
+#define INSTRUCTION_B(i) (((i) >> 16) & 0xFF)
+#define INSTRUCTION_C(i) (((i) >> 24) & 0xFF)
+#define INSTRUCTION_BX(i) ((i) >> 16)
+#define INSTRUCTION_SBX(i) ((int)INSTRUCTION_BX(i) - SBX_BIAS)
+
+#define ENCODE_ABC(op, a, b, c)                                                \
+	((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(b) << 16) |           \
+	 ((uint32_t)(c) << 24))
+#define ENCODE_ABX(op, a, bx)                                                  \
+	((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(bx) << 16))
+
+#define MAX_BX 0xFFFF
+#define SBX_BIAS 0x7FFF
+#define MAX_REGISTERS 256
+
+// Opcodes
+// R(x) = registrador, K(x) = constante, G(x) = global, U(x) = upvalue
+// Variável ainda sem var cai na instrução seguinte, que tenta a de fora
+// Definida, pula as C instruções dessa cadeia
+typedef enum {
+	OP_MOVE = 0,  // R(A) = R(B)
+	OP_LOADK,     // R(A) = K(Bx)
+	OP_LOADI,     // R(A) = sBx
+	OP_LOADNULL,  // R(A) = null
+	OP_LOADBOOL,  // R(A) = B != 0
+	OP_GETGLOBAL, // R(A) = G(Bx)
+	OP_SETGLOBAL, // G(Bx) = R(A), G(Bx) precisa existir
+	OP_DEFGLOBAL, // G(Bx) = R(A)
+	OP_GETLOCAL,  // R(A) = R(B), se definida pc += C
+	OP_SETLOCAL,  // R(A) = R(B) e pc += C, se R(A) definida
+	OP_GETUPVAL,  // R(A) = U(B), se definida pc += C
+	OP_SETUPVAL,  // U(B) = R(A), com C só se definida, e pc += C
+	OP_GETCELL,   // R(A) = cell(R(B)), se definida pc += C
+	OP_SETCELL,   // cell(R(A)) = R(B), com C só se definida, e pc += C
+	OP_BOX,       // R(A) = cell(R(A))
+	OP_CLOSURE,   // R(A) = closure(children[Bx])
+
+	OP_ADD, // R(A) = R(B) op R(C)
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_MOD,
+	OP_SHL,
+	OP_SHR,
+	OP_BAND,
+	OP_BOR,
+	OP_BXOR,
+	OP_EQ,
+	OP_NEQ,
+	OP_LT,
+	OP_GT,
+	OP_LTE,
+	OP_GTE,
+
+	OP_NEGATE,   // R(A) = -R(B)
+	OP_POSITIVE, // R(A) = +R(B)
+	OP_BIT_NOT,  // R(A) = ~R(B)
+	OP_NOT,      // R(A) = not R(B)
+
+	OP_JMP,      // pc += sBx
+	OP_JMPIF,    // if R(A) then pc += sBx
+	OP_JMPIFNOT, // if not R(A) then pc += sBx
+	OP_LOOP,     // pc += sBx, volta para o início de um loop
+	OP_FORPREP,  // R(A) e R(A+1) inteiros, if not R(A) < R(A+1) then pc += sBx
+	OP_FORLOOP,  // R(A)++, if R(A) < R(A+1) then pc += sBx
+
+	OP_CALL,      // R(A) = R(A)(R(A+1), ..., R(A+B))
+	OP_TAILCALL,  // return R(A)(R(A+1), ..., R(A+B)), no frame atual
+	OP_RETURN,    // return R(A)
+	OP_RETURNNULL // return null
+} OpCode;
+
+// De onde vem um upvalue na hora de criar a closure
+typedef struct {
+	bool fromParent; // true: registrador do pai, false: upvalue do pai
+	uint8_t index;
+} UpvalueInfo;
+
+// Código de uma função
+typedef struct Chunk {
+	uint32_t *code;
+	Token *tokens; // Token de cada instrução, para erros
+	size_t count;
+	size_t capacity;
+
+	Value *constants;
+	size_t constantCount;
+	size_t constantCapacity;
+
+	struct Chunk **children;
+	size_t childCount;
+	size_t childCapacity;
+
+	UpvalueInfo *upvalues;
+	size_t upvalueCount;
+
+	size_t paramCount;
+	size_t registerCount;
+
+	const char *name;
+	size_t nameLength;
+} Chunk;
+
+Chunk *chunkCreate(const char *name, size_t nameLength);
+size_t chunkEmit(Chunk *chunk, uint32_t instruction, Token token);
+size_t chunkAddConstant(Chunk *chunk, Value value);
+size_t chunkAddChild(Chunk *chunk, Chunk *child);
+bool chunkAddUpvalue(Chunk *chunk, UpvalueInfo upvalue);
+void chunkDump(Chunk *chunk, int depth);
+void chunkDestroy(Chunk *chunk);
@@ -0,0 +1,1284 @@
+/**
+ * compiler.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "compiler.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util.h"
+
+// Lista de nomes, usada na análise de variáveis capturadas
+typedef struct {
+	Symbol *data;
+	size_t count;
+	size_t capacity;
+} NameList;
+
+// Variável local, vive num registrador
+typedef struct {
+	Symbol symbol;
+	uint8_t reg;
+	bool captured; // Se true, o registrador guarda uma cell
+	bool param;
+	bool early; // Pode ser usada antes do var, os acessos conferem
+} Local;
+
+// Estado da função sendo compilada
+typedef struct FunctionState {
+	struct FunctionState *parent;
+	Chunk *chunk;
+	bool isScript; // Nível global: variáveis são globais
+
+	Local *locals;
+	size_t localCount;
+	size_t localCapacity;
+
+	size_t freeReg; // Primeiro registrador temporário livre
+} FunctionState;
+
+typedef struct {
+	VM *vm;
+	FunctionState *function;
+	bool hadError;
+} Compiler;
+
+// Onde uma variável mora
+typedef enum {
+	VARIABLE_LOCAL,
+	VARIABLE_CELL,
+	VARIABLE_UPVALUE,
+	VARIABLE_GLOBAL
+} VariableKind;
+
+static void compileStatement(Compiler *c, AstNode *node);
+static void compileExpressionTo(Compiler *c, AstNode *node, uint8_t dst);
+static uint8_t compileExpressionAny(Compiler *c, AstNode *node);
+
+// Nomes
+
+static bool nameListContains(NameList *list, Symbol symbol) {
+	for (size_t i = 0; i < list->count; i++) {
+		if (list->data[i] == symbol)
+			return true;
+	}
+	return false;
+}
+
+// Adiciona um nome se ainda não estiver na lista
+static void nameListAdd(NameList *list, Symbol symbol) {
+	if (nameListContains(list, symbol))
+		return;
+
+	if (list->count >= list->capacity) {
+		size_t newCapacity = list->capacity ? list->capacity * 2 : 8;
+		Symbol *newData =
+		    (Symbol *)realloc(list->data, newCapacity * sizeof(Symbol));
+		if (!newData)
+			return;
+		list->data = newData;
+		list->capacity = newCapacity;
+	}
+
+	list->data[list->count++] = symbol;
+}
+
+static void nameListFree(NameList *list) {
+	free(list->data);
+	list->data = NULL;
+	list->count = 0;
+	list->capacity = 0;
+}
+
+// Análise
+
+static void collectFreeNames(AstNode *fn, NameList *out);
+static void collectCaptures(AstNode *node, NameList *out);
+
+// Coleta os nomes declarados num corpo de função
+// Não entra em funções aninhadas
+static void collectDeclarations(AstNode *node, NameList *out) {
+	if (!node)
+		return;
+
+	switch (node->type) {
+	case NODE_PROGRAM: {
+		for (size_t i = 0; i < node->data.program.count; i++)
+			collectDeclarations(node->data.program.statements[i], out);
+	} break;
+	case NODE_BLOCK_STATEMENT: {
+		for (size_t i = 0; i < node->data.blockStatement.count; i++)
+			collectDeclarations(node->data.blockStatement.statements[i], out);
+	} break;
+	case NODE_IF_STATEMENT: {
+		collectDeclarations(node->data.ifStatement.thenBranch, out);
+		collectDeclarations(node->data.ifStatement.elseBranch, out);
+	} break;
+	case NODE_RETURN_STATEMENT: {
+		collectDeclarations(node->data.returnStatement.statement, out);
+	} break;
+	case NODE_VAR_STATEMENT: {
+		AstNode *identifier = node->data.varStatement.identifier;
+		nameListAdd(out, identifier->data.identifier.symbol);
+	} break;
+	case NODE_FN_STATEMENT: {
+		AstNode *identifier = node->data.fnStatement.functionName;
+		nameListAdd(out, identifier->data.identifier.symbol);
+	} break;
+	case NODE_WHILE_STATEMENT: {
+		collectDeclarations(node->data.whileStatement.statement, out);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		AstNode *identifier = node->data.forStatement.identifier;
+		nameListAdd(out, identifier->data.identifier.symbol);
+		collectDeclarations(node->data.forStatement.statement, out);
+	} break;
+	default:
+		break;
+	}
+}
+
+// Coleta os nomes usados num trecho
+// Não entra em funções aninhadas, essas vêm de collectCaptures
+static void collectUses(AstNode *node, NameList *out) {
+	if (!node)
+		return;
+
+	switch (node->type) {
+	case NODE_PROGRAM: {
+		for (size_t i = 0; i < node->data.program.count; i++)
+			collectUses(node->data.program.statements[i], out);
+	} break;
+	case NODE_BLOCK_STATEMENT: {
+		for (size_t i = 0; i < node->data.blockStatement.count; i++)
+			collectUses(node->data.blockStatement.statements[i], out);
+	} break;
+	case NODE_EXPRESSION_STATEMENT: {
+		collectUses(node->data.expressionStatement.expression, out);
+	} break;
+	case NODE_IF_STATEMENT: {
+		collectUses(node->data.ifStatement.condition, out);
+		collectUses(node->data.ifStatement.thenBranch, out);
+		collectUses(node->data.ifStatement.elseBranch, out);
+	} break;
+	case NODE_RETURN_STATEMENT: {
+		collectUses(node->data.returnStatement.statement, out);
+	} break;
+	case NODE_VAR_STATEMENT: {
+		collectUses(node->data.varStatement.expression, out);
+	} break;
+	case NODE_WHILE_STATEMENT: {
+		collectUses(node->data.whileStatement.condition, out);
+		collectUses(node->data.whileStatement.statement, out);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		collectUses(node->data.forStatement.start, out);
+		collectUses(node->data.forStatement.end, out);
+		collectUses(node->data.forStatement.statement, out);
+	} break;
+	case NODE_IDENTIFIER: {
+		nameListAdd(out, node->data.identifier.symbol);
+	} break;
+	case NODE_BINARYOP:
+	case NODE_LOGICAL: {
+		collectUses(node->data.binaryOp.left, out);
+		collectUses(node->data.binaryOp.right, out);
+	} break;
+	case NODE_CONDITIONAL: {
+		collectUses(node->data.conditional.condition, out);
+		collectUses(node->data.conditional.thenExpression, out);
+		collectUses(node->data.conditional.elseExpression, out);
+	} break;
+	case NODE_UNARYOP: {
+		collectUses(node->data.unaryOp.operand, out);
+	} break;
+	case NODE_ASSIGNMENT: {
+		collectUses(node->data.assigment.target, out);
+		collectUses(node->data.assigment.value, out);
+	} break;
+	case NODE_CALL: {
+		collectUses(node->data.call.callee, out);
+		for (size_t i = 0; i < node->data.call.argc; i++)
+			collectUses(node->data.call.args[i], out);
+	} break;
+	default:
+		break;
+	}
+}
+
+// Coleta os nomes que podem ser usados antes do seu var num corpo
+// defined tem os nomes com certeza já definidos até aqui
+// Funções aninhadas ficam de fora, os upvalues sempre conferem
+static void collectEarlyUses(AstNode *node, NameList *defined,
+                             NameList *out) {
+	if (!node)
+		return;
+
+	switch (node->type) {
+	case NODE_BLOCK_STATEMENT: {
+		for (size_t i = 0; i < node->data.blockStatement.count; i++)
+			collectEarlyUses(node->data.blockStatement.statements[i], defined,
+			                 out);
+	} break;
+	case NODE_EXPRESSION_STATEMENT: {
+		collectEarlyUses(node->data.expressionStatement.expression, defined,
+		                 out);
+	} break;
+	case NODE_IF_STATEMENT: {
+		// O que um ramo define não vale depois do if
+		collectEarlyUses(node->data.ifStatement.condition, defined, out);
+		size_t count = defined->count;
+		collectEarlyUses(node->data.ifStatement.thenBranch, defined, out);
+		defined->count = count;
+		collectEarlyUses(node->data.ifStatement.elseBranch, defined, out);
+		defined->count = count;
+	} break;
+	case NODE_RETURN_STATEMENT: {
+		collectEarlyUses(node->data.returnStatement.statement, defined, out);
+	} break;
+	case NODE_VAR_STATEMENT: {
+		collectEarlyUses(node->data.varStatement.expression, defined, out);
+		AstNode *identifier = node->data.varStatement.identifier;
+		nameListAdd(defined, identifier->data.identifier.symbol);
+	} break;
+	case NODE_FN_STATEMENT: {
+		AstNode *identifier = node->data.fnStatement.functionName;
+		nameListAdd(defined, identifier->data.identifier.symbol);
+	} break;
+	case NODE_WHILE_STATEMENT: {
+		// O corpo pode rodar nenhuma vez
+		size_t count = defined->count;
+		collectEarlyUses(node->data.whileStatement.condition, defined, out);
+		collectEarlyUses(node->data.whileStatement.statement, defined, out);
+		defined->count = count;
+	} break;
+	case NODE_FOR_STATEMENT: {
+		collectEarlyUses(node->data.forStatement.start, defined, out);
+		collectEarlyUses(node->data.forStatement.end, defined, out);
+		size_t count = defined->count;
+		AstNode *identifier = node->data.forStatement.identifier;
+		nameListAdd(defined, identifier->data.identifier.symbol);
+		collectEarlyUses(node->data.forStatement.statement, defined, out);
+		defined->count = count;
+	} break;
+	case NODE_IDENTIFIER: {
+		if (!nameListContains(defined, node->data.identifier.symbol))
+			nameListAdd(out, node->data.identifier.symbol);
+	} break;
+	case NODE_BINARYOP:
+	case NODE_LOGICAL: {
+		collectEarlyUses(node->data.binaryOp.left, defined, out);
+		collectEarlyUses(node->data.binaryOp.right, defined, out);
+	} break;
+	case NODE_CONDITIONAL: {
+		collectEarlyUses(node->data.conditional.condition, defined, out);
+		collectEarlyUses(node->data.conditional.thenExpression, defined, out);
+		collectEarlyUses(node->data.conditional.elseExpression, defined, out);
+	} break;
+	case NODE_UNARYOP: {
+		collectEarlyUses(node->data.unaryOp.operand, defined, out);
+	} break;
+	case NODE_ASSIGNMENT: {
+		collectEarlyUses(node->data.assigment.value, defined, out);
+		collectEarlyUses(node->data.assigment.target, defined, out);
+	} break;
+	case NODE_CALL: {
+		collectEarlyUses(node->data.call.callee, defined, out);
+		for (size_t i = 0; i < node->data.call.argc; i++)
+			collectEarlyUses(node->data.call.args[i], defined, out);
+	} break;
+	default:
+		break;
+	}
+}
+
+// Coleta os nomes das locais de uma função que podem ser usadas antes do var
+static void collectEarlyLocals(AstNode *fn, NameList *out) {
+	NameList defined = {0};
+	for (size_t i = 0; i < fn->data.fnStatement.paramCount; i++) {
+		AstNode *param = fn->data.fnStatement.params[i];
+		nameListAdd(&defined, param->data.identifier.symbol);
+	}
+
+	collectEarlyUses(fn->data.fnStatement.statement, &defined, out);
+	nameListFree(&defined);
+}
+
+// Coleta os nomes que uma função pode procurar nas funções de fora
+// Além dos não declarados, uma local usada antes do var cai na de fora,
+// como no eval, e os upvalues das aninhadas também
+static void collectFreeNames(AstNode *fn, NameList *out) {
+	NameList params = {0};
+	NameList declared = {0};
+	NameList used = {0};
+	NameList nested = {0};
+
+	for (size_t i = 0; i < fn->data.fnStatement.paramCount; i++) {
+		AstNode *param = fn->data.fnStatement.params[i];
+		nameListAdd(&params, param->data.identifier.symbol);
+		nameListAdd(&declared, param->data.identifier.symbol);
+	}
+	collectDeclarations(fn->data.fnStatement.statement, &declared);
+	collectUses(fn->data.fnStatement.statement, &used);
+	collectCaptures(fn->data.fnStatement.statement, &nested);
+
+	for (size_t i = 0; i < used.count; i++) {
+		if (!nameListContains(&declared, used.data[i]))
+			nameListAdd(out, used.data[i]);
+	}
+
+	// Parâmetros sempre estão definidos, não caem para fora
+	for (size_t i = 0; i < nested.count; i++) {
+		if (!nameListContains(&params, nested.data[i]))
+			nameListAdd(out, nested.data[i]);
+	}
+	collectEarlyLocals(fn, out);
+
+	nameListFree(&params);
+	nameListFree(&declared);
+	nameListFree(&used);
+	nameListFree(&nested);
+}
+
+// Coleta os nomes livres das funções aninhadas num corpo
+// São as locais que precisam virar cells
+static void collectCaptures(AstNode *node, NameList *out) {
+	if (!node)
+		return;
+
+	switch (node->type) {
+	case NODE_PROGRAM: {
+		for (size_t i = 0; i < node->data.program.count; i++)
+			collectCaptures(node->data.program.statements[i], out);
+	} break;
+	case NODE_BLOCK_STATEMENT: {
+		for (size_t i = 0; i < node->data.blockStatement.count; i++)
+			collectCaptures(node->data.blockStatement.statements[i], out);
+	} break;
+	case NODE_IF_STATEMENT: {
+		collectCaptures(node->data.ifStatement.thenBranch, out);
+		collectCaptures(node->data.ifStatement.elseBranch, out);
+	} break;
+	case NODE_RETURN_STATEMENT: {
+		collectCaptures(node->data.returnStatement.statement, out);
+	} break;
+	case NODE_WHILE_STATEMENT: {
+		collectCaptures(node->data.whileStatement.statement, out);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		collectCaptures(node->data.forStatement.statement, out);
+	} break;
+	case NODE_FN_STATEMENT: {
+		collectFreeNames(node, out);
+	} break;
+	default:
+		break;
+	}
+}
+
+// Retorna true se a expressão tem uma atribuição
+static bool hasAssignment(AstNode *node) {
+	if (!node)
+		return false;
+
+	switch (node->type) {
+	case NODE_ASSIGNMENT:
+		return true;
+	case NODE_BINARYOP:
+	case NODE_LOGICAL:
+		return hasAssignment(node->data.binaryOp.left) ||
+		       hasAssignment(node->data.binaryOp.right);
+	case NODE_CONDITIONAL:
+		return hasAssignment(node->data.conditional.condition) ||
+		       hasAssignment(node->data.conditional.thenExpression) ||
+		       hasAssignment(node->data.conditional.elseExpression);
+	case NODE_UNARYOP:
+		return hasAssignment(node->data.unaryOp.operand);
+	case NODE_CALL: {
+		if (hasAssignment(node->data.call.callee))
+			return true;
+		for (size_t i = 0; i < node->data.call.argc; i++) {
+			if (hasAssignment(node->data.call.args[i]))
+				return true;
+		}
+		return false;
+	}
+	default:
+		return false;
+	}
+}
+
+// Helpers
+
+// Reporta um erro de compilação
+static void compilerError(Compiler *c, AstNode *node, const char *message) {
+	c->hadError = true;
+	if (node && node->token.array) {
+		tokenLogger(LOG_ERROR, node->token, "Compile error: %s", message);
+		return;
+	}
+
+	logger(LOG_ERROR, "Compile error: %s\n", message);
+}
+
+static size_t emit(Compiler *c, uint32_t instruction, AstNode *node) {
+	return chunkEmit(c->function->chunk, instruction,
+	                 node ? node->token : TOKEN_NONE);
+}
+
+// Reserva um registrador temporário
+static uint8_t allocRegister(Compiler *c, AstNode *node) {
+	FunctionState *fs = c->function;
+	if (fs->freeReg >= MAX_REGISTERS) {
+		compilerError(c, node, "Too many registers in function");
+		return 0;
+	}
+
+	uint8_t reg = (uint8_t)fs->freeReg++;
+	if (fs->freeReg > fs->chunk->registerCount)
+		fs->chunk->registerCount = fs->freeReg;
+	return reg;
+}
+
+// Emite um salto para ser corrigido depois
+static size_t emitJump(Compiler *c, OpCode op, uint8_t reg, AstNode *node) {
+	return emit(c, ENCODE_ABX(op, reg, SBX_BIAS), node);
+}
+
+// Faz um salto apontar para a próxima instrução
+static void patchJump(Compiler *c, size_t jump, AstNode *node) {
+	Chunk *chunk = c->function->chunk;
+	long offset = (long)chunk->count - (long)jump - 1;
+	if (offset > MAX_BX - SBX_BIAS) {
+		compilerError(c, node, "Jump too long");
+		return;
+	}
+
+	uint32_t instruction = chunk->code[jump];
+	chunk->code[jump] =
+	    ENCODE_ABX(INSTRUCTION_OP(instruction), INSTRUCTION_A(instruction),
+	               (uint32_t)(offset + SBX_BIAS));
+}
+
+// Emite um salto de volta para start
+static void emitLoop(Compiler *c, OpCode op, uint8_t reg, size_t start,
+                     AstNode *node) {
+	long offset = (long)start - (long)c->function->chunk->count - 1;
+	if (offset < -SBX_BIAS) {
+		compilerError(c, node, "Loop body too long");
+		return;
+	}
+
+	emit(c, ENCODE_ABX(op, reg, (uint32_t)(offset + SBX_BIAS)), node);
+}
+
+static Local *findLocal(FunctionState *fs, Symbol symbol) {
+	for (size_t i = fs->localCount; i > 0; i--) {
+		Local *local = &fs->locals[i - 1];
+		if (local->symbol == symbol)
+			return local;
+	}
+	return NULL;
+}
+
+// Declara uma local no próximo registrador
+static Local *addLocal(Compiler *c, Symbol symbol, AstNode *node) {
+	FunctionState *fs = c->function;
+	if (fs->localCount >= fs->localCapacity) {
+		size_t newCapacity = fs->localCapacity ? fs->localCapacity * 2 : 8;
+		Local *newLocals =
+		    (Local *)realloc(fs->locals, newCapacity * sizeof(Local));
+		if (!newLocals) {
+			compilerError(c, node, "Failed to alloc locals");
+			return NULL;
+		}
+		fs->locals = newLocals;
+		fs->localCapacity = newCapacity;
+	}
+
+	Local *local = &fs->locals[fs->localCount++];
+	local->symbol = symbol;
+	local->reg = allocRegister(c, node);
+	local->captured = false;
+	local->param = false;
+	local->early = false;
+	return local;
+}
+
+// Adiciona um upvalue na função, reaproveitando se já existir
+static int addUpvalue(Compiler *c, FunctionState *fs, bool fromParent,
+                      uint8_t index, AstNode *node) {
+	Chunk *chunk = fs->chunk;
+	for (size_t i = 0; i < chunk->upvalueCount; i++) {
+		if (chunk->upvalues[i].fromParent == fromParent &&
+		    chunk->upvalues[i].index == index)
+			return (int)i;
+	}
+
+	if (chunk->upvalueCount >= MAX_REGISTERS) {
+		compilerError(c, node, "Too many captured variables in function");
+		return -1;
+	}
+
+	UpvalueInfo info;
+	info.fromParent = fromParent;
+	info.index = index;
+	if (!chunkAddUpvalue(chunk, info)) {
+		compilerError(c, node, "Failed to alloc upvalue");
+		return -1;
+	}
+
+	return (int)chunk->upvalueCount - 1;
+}
+
+// Procura uma variável nas funções de fora
+// As funções até shadow já foram tentadas e ficam de fora da busca
+// owner recebe a função que declara a variável
+static int resolveUpvalue(Compiler *c, FunctionState *fs, Symbol symbol,
+                          FunctionState *shadow, FunctionState **owner,
+                          AstNode *node) {
+	FunctionState *parent = fs->parent;
+	if (!parent || parent->isScript)
+		return -1;
+
+	Local *local = shadow ? NULL : findLocal(parent, symbol);
+	if (local) {
+		if (!local->captured) {
+			compilerError(c, node, "Internal error: Variable not captured");
+			return -1;
+		}
+		*owner = parent;
+		return addUpvalue(c, fs, true, local->reg, node);
+	}
+
+	int index = resolveUpvalue(c, parent, symbol,
+	                           parent == shadow ? NULL : shadow, owner, node);
+	if (index < 0)
+		return -1;
+
+	return addUpvalue(c, fs, false, (uint8_t)index, node);
+}
+
+// Índice da global de um identificador
+static size_t globalIndex(Compiler *c, AstNode *identifier) {
+	size_t global = vmGlobalIndex(c->vm, identifier->data.identifier.symbol);
+	if (global > MAX_BX || global >= c->vm->globalCount) {
+		compilerError(c, identifier, "Too many globals");
+		return 0;
+	}
+	return global;
+}
+
+// Resolve um identificador
+static VariableKind resolve(Compiler *c, AstNode *identifier, int *index) {
+	FunctionState *fs = c->function;
+	Symbol symbol = identifier->data.identifier.symbol;
+
+	if (!fs->isScript) {
+		Local *local = findLocal(fs, symbol);
+		if (local) {
+			*index = local->reg;
+			return local->captured ? VARIABLE_CELL : VARIABLE_LOCAL;
+		}
+
+		FunctionState *owner = NULL;
+		int upvalue = resolveUpvalue(c, fs, symbol, NULL, &owner, identifier);
+		if (upvalue >= 0) {
+			*index = upvalue;
+			return VARIABLE_UPVALUE;
+		}
+	}
+
+	*index = (int)globalIndex(c, identifier);
+	return VARIABLE_GLOBAL;
+}
+
+// Local num registrador que pode ser usada direto, sem conferir
+static Local *directLocal(Compiler *c, AstNode *identifier, bool define) {
+	FunctionState *fs = c->function;
+	if (fs->isScript)
+		return NULL;
+
+	Local *local = findLocal(fs, identifier->data.identifier.symbol);
+	if (!local || local->captured || (local->early && !define))
+		return NULL;
+	return local;
+}
+
+// Lê (store false) ou escreve (store true) uma variável usando reg
+// Antes do var o eval cai na variável de fora com o mesmo nome, então o
+// acesso vira uma cadeia até a global: o primeiro elo definido pula o resto
+static void accessVariable(Compiler *c, AstNode *identifier, uint8_t reg,
+                           bool store) {
+	FunctionState *fs = c->function;
+	Symbol symbol = identifier->data.identifier.symbol;
+	size_t start = fs->chunk->count;
+	bool done = false;
+
+	Local *local = fs->isScript ? NULL : findLocal(fs, symbol);
+	if (local) {
+		OpCode op = OP_MOVE;
+		if (local->captured)
+			op = store ? OP_SETCELL : OP_GETCELL;
+		else if (local->early)
+			op = store ? OP_SETLOCAL : OP_GETLOCAL;
+
+		if (op != OP_MOVE || local->reg != reg) {
+			uint8_t a = store ? local->reg : reg;
+			uint8_t b = store ? reg : local->reg;
+			emit(c, ENCODE_ABC(op, a, b, 0), identifier);
+		}
+		done = !local->early;
+	}
+
+	FunctionState *shadow = NULL;
+	while (!done && !fs->isScript) {
+		FunctionState *owner = NULL;
+		int index =
+		    resolveUpvalue(c, fs, symbol, shadow, &owner, identifier);
+		if (index < 0)
+			break;
+
+		emit(c,
+		     ENCODE_ABC(store ? OP_SETUPVAL : OP_GETUPVAL, reg, index, 0),
+		     identifier);
+		done = findLocal(owner, symbol)->param;
+		shadow = owner;
+	}
+
+	if (!done)
+		emit(c,
+		     ENCODE_ABX(store ? OP_SETGLOBAL : OP_GETGLOBAL, reg,
+		                globalIndex(c, identifier)),
+		     identifier);
+
+	// Cada elo pula até o fim da cadeia, o último pula 0
+	Chunk *chunk = fs->chunk;
+	for (size_t i = start; i < chunk->count; i++) {
+		OpCode op = INSTRUCTION_OP(chunk->code[i]);
+		if (op == OP_GETGLOBAL || op == OP_SETGLOBAL)
+			continue;
+
+		size_t skip = chunk->count - i - 1;
+		if (skip > 0xFF) {
+			compilerError(c, identifier, "Too many nested functions");
+			return;
+		}
+		chunk->code[i] = ENCODE_ABC(op, INSTRUCTION_A(chunk->code[i]),
+		                            INSTRUCTION_B(chunk->code[i]), skip);
+	}
+}
+
+// Guarda o valor de um registrador numa variável
+// Definir (var, fn, for) nunca confere, a variável é sempre a da função
+static void storeVariable(Compiler *c, AstNode *identifier, uint8_t src,
+                          bool define) {
+	if (!define) {
+		accessVariable(c, identifier, src, true);
+		return;
+	}
+
+	int index = 0;
+	VariableKind kind = resolve(c, identifier, &index);
+
+	switch (kind) {
+	case VARIABLE_LOCAL: {
+		if (index != src)
+			emit(c, ENCODE_ABC(OP_MOVE, index, src, 0), identifier);
+	} break;
+	case VARIABLE_CELL: {
+		emit(c, ENCODE_ABC(OP_SETCELL, index, src, 0), identifier);
+	} break;
+	case VARIABLE_UPVALUE: {
+		emit(c, ENCODE_ABC(OP_SETUPVAL, src, index, 0), identifier);
+	} break;
+	case VARIABLE_GLOBAL: {
+		emit(c, ENCODE_ABX(OP_DEFGLOBAL, src, index), identifier);
+	} break;
+	}
+}
+
+// Compila um valor direto para uma variável
+static void compileStore(Compiler *c, AstNode *identifier, AstNode *value,
+                         bool define) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	Local *local = directLocal(c, identifier, define);
+	if (local) {
+		compileExpressionTo(c, value, local->reg);
+	} else {
+		uint8_t src = compileExpressionAny(c, value);
+		storeVariable(c, identifier, src, define);
+	}
+
+	fs->freeReg = mark;
+}
+
+// Funções
+
+// Compila o corpo de uma função num chunk novo
+static Chunk *compileFunction(Compiler *c, AstNode *fn) {
+	AstNode *functionName = fn->data.fnStatement.functionName;
+
+	FunctionState fs = {0};
+	fs.parent = c->function;
+	Symbol name = functionName->data.identifier.symbol;
+	fs.chunk = chunkCreate(symbolName(name), symbolLength(name));
+	if (!fs.chunk) {
+		compilerError(c, fn, "Failed to alloc chunk");
+		return NULL;
+	}
+	fs.chunk->paramCount = fn->data.fnStatement.paramCount;
+	c->function = &fs;
+
+	// Parâmetros ficam nos primeiros registradores
+	for (size_t i = 0; i < fn->data.fnStatement.paramCount; i++) {
+		AstNode *param = fn->data.fnStatement.params[i];
+		Local *local = addLocal(c, param->data.identifier.symbol, param);
+		if (local)
+			local->param = true;
+	}
+
+	// Variáveis valem para a função inteira, começando indefinidas
+	NameList declared = {0};
+	NameList early = {0};
+	collectDeclarations(fn->data.fnStatement.statement, &declared);
+	collectEarlyLocals(fn, &early);
+	for (size_t i = 0; i < declared.count; i++) {
+		if (findLocal(&fs, declared.data[i]))
+			continue;
+
+		Local *local = addLocal(c, declared.data[i], fn);
+		if (local)
+			local->early = nameListContains(&early, declared.data[i]);
+	}
+	nameListFree(&declared);
+	nameListFree(&early);
+
+	// Locais usadas por funções aninhadas vão para cells
+	NameList captures = {0};
+	collectCaptures(fn->data.fnStatement.statement, &captures);
+	for (size_t i = 0; i < fs.localCount; i++) {
+		Local *local = &fs.locals[i];
+		if (!nameListContains(&captures, local->symbol))
+			continue;
+
+		local->captured = true;
+		emit(c, ENCODE_ABC(OP_BOX, local->reg, 0, 0), fn);
+	}
+	nameListFree(&captures);
+
+	compileStatement(c, fn->data.fnStatement.statement);
+	emit(c, ENCODE_ABC(OP_RETURNNULL, 0, 0, 0), fn);
+
+	c->function = fs.parent;
+	free(fs.locals);
+	return fs.chunk;
+}
+
+// Expressões
+
+// Compila uma expressão e retorna o registrador com o resultado
+// Locais são usadas direto, sem cópia
+static uint8_t compileExpressionAny(Compiler *c, AstNode *node) {
+	if (node && node->type == NODE_IDENTIFIER) {
+		Local *local = directLocal(c, node, false);
+		if (local)
+			return local->reg;
+	}
+
+	uint8_t reg = allocRegister(c, node);
+	compileExpressionTo(c, node, reg);
+	return reg;
+}
+
+// Compila o operando esquerdo de um operador binário
+// Copia a local se o lado direito puder mudar ela antes
+static uint8_t compileLeftOperand(Compiler *c, AstNode *left, AstNode *right) {
+	if (!hasAssignment(right))
+		return compileExpressionAny(c, left);
+
+	uint8_t reg = allocRegister(c, left);
+	compileExpressionTo(c, left, reg);
+	return reg;
+}
+
+// Opcode de um operador binário
+static bool binaryOpcode(TokenType op, OpCode *out) {
+	switch (op) {
+	case TOKEN_PLUS:
+		*out = OP_ADD;
+		return true;
+	case TOKEN_MINUS:
+		*out = OP_SUB;
+		return true;
+	case TOKEN_STAR:
+		*out = OP_MUL;
+		return true;
+	case TOKEN_SLASH:
+		*out = OP_DIV;
+		return true;
+	case TOKEN_PERCENT:
+		*out = OP_MOD;
+		return true;
+	case TOKEN_SHIFT_LEFT:
+		*out = OP_SHL;
+		return true;
+	case TOKEN_SHIFT_RIGHT:
+		*out = OP_SHR;
+		return true;
+	case TOKEN_BIT_AND:
+		*out = OP_BAND;
+		return true;
+	case TOKEN_BIT_OR:
+		*out = OP_BOR;
+		return true;
+	case TOKEN_BIT_XOR:
+		*out = OP_BXOR;
+		return true;
+	case TOKEN_EQ:
+		*out = OP_EQ;
+		return true;
+	case TOKEN_NEQ:
+		*out = OP_NEQ;
+		return true;
+	case TOKEN_LT:
+		*out = OP_LT;
+		return true;
+	case TOKEN_GT:
+		*out = OP_GT;
+		return true;
+	case TOKEN_LTE:
+		*out = OP_LTE;
+		return true;
+	case TOKEN_GTE:
+		*out = OP_GTE;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Opcode de um operador unário
+static bool unaryOpcode(TokenType op, OpCode *out) {
+	switch (op) {
+	case TOKEN_MINUS:
+		*out = OP_NEGATE;
+		return true;
+	case TOKEN_PLUS:
+		*out = OP_POSITIVE;
+		return true;
+	case TOKEN_BIT_NOT:
+		*out = OP_BIT_NOT;
+		return true;
+	case TOKEN_NOT:
+		*out = OP_NOT;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Call
+// Callee e argumentos em registradores seguidos, resultado no do callee
+static void compileCall(Compiler *c, AstNode *node, uint8_t dst) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	if (node->data.call.argc >= MAX_REGISTERS) {
+		compilerError(c, node, "Too many arguments");
+		return;
+	}
+
+	uint8_t base = allocRegister(c, node);
+	compileExpressionTo(c, node->data.call.callee, base);
+
+	for (size_t i = 0; i < node->data.call.argc; i++) {
+		uint8_t reg = allocRegister(c, node->data.call.args[i]);
+		compileExpressionTo(c, node->data.call.args[i], reg);
+	}
+
+	emit(c, ENCODE_ABC(OP_CALL, base, node->data.call.argc, 0), node);
+	if (dst != base)
+		emit(c, ENCODE_ABC(OP_MOVE, dst, base, 0), node);
+
+	fs->freeReg = mark;
+}
+
+// Return de uma chamada dentro de função
+// O callee assume o frame atual em vez de empilhar outro
+static void compileTailCall(Compiler *c, AstNode *node) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	if (node->data.call.argc >= MAX_REGISTERS) {
+		compilerError(c, node, "Too many arguments");
+		return;
+	}
+
+	uint8_t base = allocRegister(c, node);
+	compileExpressionTo(c, node->data.call.callee, base);
+
+	for (size_t i = 0; i < node->data.call.argc; i++) {
+		uint8_t reg = allocRegister(c, node->data.call.args[i]);
+		compileExpressionTo(c, node->data.call.args[i], reg);
+	}
+
+	emit(c, ENCODE_ABC(OP_TAILCALL, base, node->data.call.argc, 0), node);
+
+	fs->freeReg = mark;
+}
+
+// and/or
+// Saltos em vez de avaliar os dois lados, o resultado é sempre boolean
+static void compileLogical(Compiler *c, AstNode *node, uint8_t dst) {
+	bool isAnd = node->data.binaryOp.op == TOKEN_AND;
+	OpCode decide = isAnd ? OP_JMPIFNOT : OP_JMPIF;
+
+	uint8_t left = compileExpressionAny(c, node->data.binaryOp.left);
+	size_t leftJump = emitJump(c, decide, left, node);
+	uint8_t right = compileExpressionAny(c, node->data.binaryOp.right);
+	size_t rightJump = emitJump(c, decide, right, node);
+
+	// Nenhum lado decidiu: and deu true, or deu false
+	emit(c, ENCODE_ABC(OP_LOADBOOL, dst, isAnd, 0), node);
+	size_t endJump = emitJump(c, OP_JMP, 0, node);
+	patchJump(c, leftJump, node);
+	patchJump(c, rightJump, node);
+	emit(c, ENCODE_ABC(OP_LOADBOOL, dst, !isAnd, 0), node);
+	patchJump(c, endJump, node);
+}
+
+// c ? a : b
+// Os dois lados escrevem no mesmo registrador, só um deles roda
+static void compileConditional(Compiler *c, AstNode *node, uint8_t dst) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	uint8_t condition =
+	    compileExpressionAny(c, node->data.conditional.condition);
+	size_t elseJump = emitJump(c, OP_JMPIFNOT, condition, node);
+	fs->freeReg = mark;
+
+	compileExpressionTo(c, node->data.conditional.thenExpression, dst);
+	size_t endJump = emitJump(c, OP_JMP, 0, node);
+	patchJump(c, elseJump, node);
+	compileExpressionTo(c, node->data.conditional.elseExpression, dst);
+	patchJump(c, endJump, node);
+}
+
+// Compila uma expressão para um registrador específico
+static void compileExpressionTo(Compiler *c, AstNode *node, uint8_t dst) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	// Expressão obrigatória que faltou: ast inválida, não vira null
+	if (!node) {
+		compilerError(c, NULL, "Internal error: Missing expression");
+		return;
+	}
+
+	switch (node->type) {
+	case NODE_NUMBER: {
+		long long value = node->data.number.value.integer;
+		if (!node->data.number.isFloat && value >= -SBX_BIAS &&
+		    value <= MAX_BX - SBX_BIAS) {
+			emit(c, ENCODE_ABX(OP_LOADI, dst, (uint32_t)(value + SBX_BIAS)),
+			     node);
+			break;
+		}
+
+		Value constant = node->data.number.isFloat
+		                     ? floating(node->data.number.value.floating)
+		                     : integer(value);
+		size_t index = chunkAddConstant(fs->chunk, constant);
+		if (index > MAX_BX) {
+			compilerError(c, node, "Too many constants");
+			break;
+		}
+		emit(c, ENCODE_ABX(OP_LOADK, dst, index), node);
+	} break;
+	case NODE_STRING: {
+		if (!node->data.string.literal)
+			node->data.string.literal =
+			    gcLiteral(node->data.string.start, node->data.string.length);
+		if (!node->data.string.literal) {
+			compilerError(c, node, "Failed to alloc string");
+			break;
+		}
+
+		size_t index =
+		    chunkAddConstant(fs->chunk, string(node->data.string.literal));
+		if (index > MAX_BX) {
+			compilerError(c, node, "Too many constants");
+			break;
+		}
+		emit(c, ENCODE_ABX(OP_LOADK, dst, index), node);
+	} break;
+	case NODE_BOOLEAN: {
+		emit(c, ENCODE_ABC(OP_LOADBOOL, dst, node->data.boolean.value, 0),
+		     node);
+	} break;
+	case NODE_NULL: {
+		emit(c, ENCODE_ABC(OP_LOADNULL, dst, 0, 0), node);
+	} break;
+	case NODE_IDENTIFIER: {
+		accessVariable(c, node, dst, false);
+	} break;
+	case NODE_ASSIGNMENT: {
+		compileStore(c, node->data.assigment.target, node->data.assigment.value,
+		             false);
+		emit(c, ENCODE_ABC(OP_LOADNULL, dst, 0, 0), node);
+	} break;
+	case NODE_BINARYOP: {
+		OpCode op;
+		if (!binaryOpcode(node->data.binaryOp.op, &op)) {
+			compilerError(c, node, "Unknown binary operator");
+			break;
+		}
+
+		uint8_t left = compileLeftOperand(c, node->data.binaryOp.left,
+		                                  node->data.binaryOp.right);
+		uint8_t right = compileExpressionAny(c, node->data.binaryOp.right);
+		emit(c, ENCODE_ABC(op, dst, left, right), node);
+	} break;
+	case NODE_UNARYOP: {
+		OpCode op;
+		if (!unaryOpcode(node->data.unaryOp.op, &op)) {
+			compilerError(c, node, "Unknown unary operator");
+			break;
+		}
+
+		uint8_t operand = compileExpressionAny(c, node->data.unaryOp.operand);
+		emit(c, ENCODE_ABC(op, dst, operand, 0), node);
+	} break;
+	case NODE_CALL: {
+		compileCall(c, node, dst);
+	} break;
+	case NODE_LOGICAL: {
+		compileLogical(c, node, dst);
+	} break;
+	case NODE_CONDITIONAL: {
+		compileConditional(c, node, dst);
+	} break;
+	default: {
+		compilerError(c, node, "Expected expression");
+	} break;
+	}
+
+	fs->freeReg = mark;
+}
+
+// Statements
+
+// Return
+static void compileReturnStatement(Compiler *c, AstNode *node) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+	AstNode *statement = node->data.returnStatement.statement;
+
+	if (statement && statement->type == NODE_EXPRESSION_STATEMENT) {
+		AstNode *expression = statement->data.expressionStatement.expression;
+		if (!fs->isScript && expression && expression->type == NODE_CALL) {
+			compileTailCall(c, expression);
+		} else {
+			uint8_t reg = compileExpressionAny(c, expression);
+			emit(c, ENCODE_ABC(OP_RETURN, reg, 0, 0), node);
+		}
+	} else {
+		if (statement && statement->type != NODE_NULL)
+			compileStatement(c, statement);
+		emit(c, ENCODE_ABC(OP_RETURNNULL, 0, 0, 0), node);
+	}
+
+	fs->freeReg = mark;
+}
+
+// If
+static void compileIfStatement(Compiler *c, AstNode *node) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	uint8_t condition = compileExpressionAny(c, node->data.ifStatement.condition);
+	size_t elseJump = emitJump(c, OP_JMPIFNOT, condition, node);
+	fs->freeReg = mark;
+
+	compileStatement(c, node->data.ifStatement.thenBranch);
+
+	if (node->data.ifStatement.elseBranch) {
+		size_t endJump = emitJump(c, OP_JMP, 0, node);
+		patchJump(c, elseJump, node);
+		compileStatement(c, node->data.ifStatement.elseBranch);
+		patchJump(c, endJump, node);
+	} else {
+		patchJump(c, elseJump, node);
+	}
+}
+
+// While
+static void compileWhileStatement(Compiler *c, AstNode *node) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	size_t loopStart = fs->chunk->count;
+	uint8_t condition =
+	    compileExpressionAny(c, node->data.whileStatement.condition);
+	size_t exitJump = emitJump(c, OP_JMPIFNOT, condition, node);
+	fs->freeReg = mark;
+
+	compileStatement(c, node->data.whileStatement.statement);
+	emitLoop(c, OP_LOOP, 0, loopStart, node);
+	patchJump(c, exitJump, node);
+}
+
+// For
+// Contador e limite ficam em dois registradores escondidos, como inteiros
+// A variável só recebe uma cópia, mudar ela não mexe no contador
+static void compileForStatement(Compiler *c, AstNode *node) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	uint8_t counter = allocRegister(c, node);
+	uint8_t limit = allocRegister(c, node);
+	compileExpressionTo(c, node->data.forStatement.start, counter);
+	compileExpressionTo(c, node->data.forStatement.end, limit);
+
+	size_t prepJump = emitJump(c, OP_FORPREP, counter, node);
+	size_t bodyStart = fs->chunk->count;
+	storeVariable(c, node->data.forStatement.identifier, counter, true);
+	compileStatement(c, node->data.forStatement.statement);
+	emitLoop(c, OP_FORLOOP, counter, bodyStart, node);
+	patchJump(c, prepJump, node);
+
+	fs->freeReg = mark;
+}
+
+// Fn
+static void compileFnStatement(Compiler *c, AstNode *node) {
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	Chunk *child = compileFunction(c, node);
+	if (!child)
+		return;
+
+	size_t index = chunkAddChild(fs->chunk, child);
+	if (index > MAX_BX || index >= fs->chunk->childCount) {
+		chunkDestroy(child);
+		compilerError(c, node, "Too many functions");
+		return;
+	}
+
+	AstNode *functionName = node->data.fnStatement.functionName;
+	int local = 0;
+	if (resolve(c, functionName, &local) == VARIABLE_LOCAL) {
+		emit(c, ENCODE_ABX(OP_CLOSURE, local, index), node);
+	} else {
+		uint8_t reg = allocRegister(c, node);
+		emit(c, ENCODE_ABX(OP_CLOSURE, reg, index), node);
+		storeVariable(c, functionName, reg, true);
+	}
+
+	fs->freeReg = mark;
+}
+
+// Statement
+static void compileStatement(Compiler *c, AstNode *node) {
+	if (!node)
+		return;
+
+	FunctionState *fs = c->function;
+	size_t mark = fs->freeReg;
+
+	switch (node->type) {
+	case NODE_BLOCK_STATEMENT: {
+		for (size_t i = 0; i < node->data.blockStatement.count; i++)
+			compileStatement(c, node->data.blockStatement.statements[i]);
+	} break;
+	case NODE_EXPRESSION_STATEMENT: {
+		AstNode *expression = node->data.expressionStatement.expression;
+		if (expression && expression->type == NODE_ASSIGNMENT) {
+			compileStore(c, expression->data.assigment.target,
+			             expression->data.assigment.value, false);
+		} else {
+			compileExpressionAny(c, expression);
+		}
+	} break;
+	case NODE_RETURN_STATEMENT: {
+		compileReturnStatement(c, node);
+	} break;
+	case NODE_IF_STATEMENT: {
+		compileIfStatement(c, node);
+	} break;
+	case NODE_VAR_STATEMENT: {
+		compileStore(c, node->data.varStatement.identifier,
+		             node->data.varStatement.expression, true);
+	} break;
+	case NODE_FN_STATEMENT: {
+		compileFnStatement(c, node);
+	} break;
+	case NODE_WHILE_STATEMENT: {
+		compileWhileStatement(c, node);
+	} break;
+	case NODE_FOR_STATEMENT: {
+		compileForStatement(c, node);
+	} break;
+	default: {
+		compileExpressionAny(c, node);
+	} break;
+	}
+
+	fs->freeReg = mark;
+}
+
+// Compila um programa
+// Retorna o chunk principal ou NULL se der erro
+Chunk *compilerCompile(AstNode *root, VM *vm) {
+	if (!root || root->type != NODE_PROGRAM || !vm) {
+		logger(LOG_ERROR, "Internal error: Failed to compile: no have ast\n");
+		return NULL;
+	}
+
+	Compiler c = {0};
+	c.vm = vm;
+
+	FunctionState fs = {0};
+	fs.chunk = chunkCreate("<script>", 8);
+	fs.isScript = true;
+	if (!fs.chunk) {
+		logger(LOG_ERROR, "Internal error: Failed to alloc chunk\n");
+		return NULL;
+	}
+	c.function = &fs;
+
+	// R0 guarda o valor do último statement, que vira o retorno do script
+	uint8_t result = allocRegister(&c, root);
+	emit(&c, ENCODE_ABC(OP_LOADNULL, result, 0, 0), root);
+
+	for (size_t i = 0; i < root->data.program.count; i++) {
+		AstNode *statement = root->data.program.statements[i];
+		if (statement->type == NODE_EXPRESSION_STATEMENT &&
+		    statement->data.expressionStatement.expression &&
+		    statement->data.expressionStatement.expression->type !=
+		        NODE_ASSIGNMENT) {
+			compileExpressionTo(
+			    &c, statement->data.expressionStatement.expression, result);
+		} else {
+			compileStatement(&c, statement);
+			emit(&c, ENCODE_ABC(OP_LOADNULL, result, 0, 0), statement);
+		}
+	}
+
+	emit(&c, ENCODE_ABC(OP_RETURN, result, 0, 0), root);
+
+	if (c.hadError) {
+		chunkDestroy(fs.chunk);
+		return NULL;
+	}
+
+	return fs.chunk;
+}
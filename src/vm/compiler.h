@@ -0,0 +1,11 @@
+/**
+ * compiler.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include "../parser/ast.h"
+#include "chunk.h"
+#include "vm.h"
+
+Chunk *compilerCompile(AstNode *root, VM *vm);
@@ -0,0 +1,774 @@
+/**
+ * vm.c
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#include "vm.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../eval/builtin.h"
+#include "../eval/operator.h"
+#include "../util.h"
+
+#define VM_STACK_INITIAL 1024
+#define VM_STACK_MAX (1 << 24)
+#define VM_FRAMES_INITIAL 64
+#define VM_FRAMES_MAX (1 << 18)
+
+// Despacho por computed goto no GCC/Clang, -DVUL_SWITCH_DISPATCH usa o switch
+#if defined(__GNUC__) && !defined(VUL_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO
+#endif
+
+// Reporta um erro de runtime no token da instrução
+static void vmError(Token token, const char *format, ...) {
+	char message[256];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+
+	if (token.array) {
+		tokenLogger(LOG_ERROR, token, "%s", message);
+		return;
+	}
+
+	logger(LOG_ERROR, "%s\n", message);
+}
+
+// Cria uma cell com um valor
+static Cell *cellCreate(Value value) {
+	Cell *cell = (Cell *)gcAllocate(GC_CELL, sizeof(Cell));
+	if (!cell)
+		return NULL;
+
+	cell->value = value;
+	return cell;
+}
+
+// Cria uma closure sem upvalues preenchidos
+static Closure *closureCreate(Chunk *chunk) {
+	Closure *closure = (Closure *)gcAllocate(
+	    GC_CLOSURE, sizeof(Closure) + chunk->upvalueCount * sizeof(Cell *));
+	if (!closure)
+		return NULL;
+
+	closure->chunk = chunk;
+	closure->upvalueCount = chunk->upvalueCount;
+	return closure;
+}
+
+// Marca as constantes de um chunk e dos filhos
+// Com VUL_NANBOX, inteiros grandes são objetos do GC
+static void vmMarkChunk(Chunk *chunk) {
+	for (size_t i = 0; i < chunk->constantCount; i++)
+		gcMarkValue(chunk->constants[i]);
+	for (size_t i = 0; i < chunk->childCount; i++)
+		vmMarkChunk(chunk->children[i]);
+}
+
+// Marca as raízes da VM: registradores em uso, frames, globais e constantes
+static void vmMarkRoots(void *data) {
+	VM *vm = (VM *)data;
+
+	// Quem chamou pode ter registradores acima da janela do frame do topo,
+	// então vale a janela mais alta entre todos os frames
+	size_t used = 0;
+	for (size_t i = 0; i < vm->frameCount; i++) {
+		CallFrame *frame = &vm->frames[i];
+		size_t end = frame->base + frame->closure->chunk->registerCount;
+		if (end > used)
+			used = end;
+		gcMarkObject(&frame->closure->object);
+	}
+
+	for (size_t i = 0; i < used; i++)
+		gcMarkValue(vm->stack[i]);
+
+	for (size_t i = 0; i < vm->globalCount; i++)
+		gcMarkValue(vm->globals[i]);
+
+	if (vm->script)
+		vmMarkChunk(vm->script);
+}
+
+// Garante que a pilha tenha pelo menos size registradores
+static bool vmReserve(VM *vm, size_t size) {
+	if (size <= vm->stackSize)
+		return true;
+	if (size > VM_STACK_MAX)
+		return false;
+
+	size_t newSize = vm->stackSize * 2;
+	if (newSize < size)
+		newSize = size;
+	if (newSize > VM_STACK_MAX)
+		newSize = VM_STACK_MAX;
+
+	Value *newStack = (Value *)realloc(vm->stack, newSize * sizeof(Value));
+	if (!newStack)
+		return false;
+
+	vm->stack = newStack;
+	vm->stackSize = newSize;
+	return true;
+}
+
+// Empilha um frame de chamada
+static CallFrame *vmPushFrame(VM *vm, Closure *closure, size_t base) {
+	if (vm->frameCount >= vm->frameCapacity) {
+		if (vm->frameCapacity >= VM_FRAMES_MAX)
+			return NULL;
+
+		size_t newCapacity = vm->frameCapacity * 2;
+		CallFrame *newFrames = (CallFrame *)realloc(
+		    vm->frames, newCapacity * sizeof(CallFrame));
+		if (!newFrames)
+			return NULL;
+
+		vm->frames = newFrames;
+		vm->frameCapacity = newCapacity;
+	}
+
+	CallFrame *frame = &vm->frames[vm->frameCount++];
+	frame->closure = closure;
+	frame->ip = closure->chunk->code;
+	frame->base = base;
+	return frame;
+}
+
+// Cria uma VM
+VM *vmCreate(Arena *arena) {
+	VM *vm = (VM *)calloc(1, sizeof(VM));
+	if (!vm)
+		return NULL;
+
+	vm->arena = arena;
+	vm->stackSize = VM_STACK_INITIAL;
+	vm->stack = (Value *)malloc(vm->stackSize * sizeof(Value));
+	vm->frameCapacity = VM_FRAMES_INITIAL;
+	vm->frames = (CallFrame *)malloc(vm->frameCapacity * sizeof(CallFrame));
+	if (!vm->stack || !vm->frames) {
+		vmDestroy(vm);
+		return NULL;
+	}
+
+	// Built-ins são os primeiros globais
+	for (size_t i = 0; builtins[i].name; i++) {
+		size_t index = vmGlobalIndex(
+		    vm, symbolIntern(builtins[i].name, builtins[i].length));
+		if (index >= vm->globalCount) {
+			vmDestroy(vm);
+			return NULL;
+		}
+
+		vm->globals[index] = builtinValue(builtins[i].function);
+	}
+
+	return vm;
+}
+
+// Retorna o índice de um global, criando se não existir
+// Usado pelo compilador
+size_t vmGlobalIndex(VM *vm, Symbol symbol) {
+	for (size_t i = 0; i < vm->globalCount; i++) {
+		if (vm->globalSymbols[i] == symbol)
+			return i;
+	}
+
+	if (vm->globalCount >= vm->globalCapacity) {
+		size_t newCapacity = vm->globalCapacity ? vm->globalCapacity * 2 : 16;
+
+		Value *newGlobals =
+		    (Value *)realloc(vm->globals, newCapacity * sizeof(Value));
+		if (!newGlobals)
+			return vm->globalCount;
+		vm->globals = newGlobals;
+
+		Symbol *newSymbols = (Symbol *)realloc(
+		    vm->globalSymbols, newCapacity * sizeof(Symbol));
+		if (!newSymbols)
+			return vm->globalCount;
+		vm->globalSymbols = newSymbols;
+
+		vm->globalCapacity = newCapacity;
+	}
+
+	vm->globals[vm->globalCount] = undefined();
+	vm->globalSymbols[vm->globalCount] = symbol;
+	return vm->globalCount++;
+}
+
+// Executa a partir do frame do topo até ele retornar
+static Value vmExecute(VM *vm) {
+	CallFrame *frame = &vm->frames[vm->frameCount - 1];
+	Closure *closure = frame->closure;
+	Chunk *chunk = closure->chunk;
+	const uint32_t *ip = frame->ip;
+	Value *base = vm->stack + frame->base;
+
+// Token da instrução atual, para erros
+#define TOKEN() (chunk->tokens[ip - 1 - chunk->code])
+
+// Operador sem caminho rápido, usa a tabela de kernels do eval
+#define BINARY_SLOW(operator)                                                  \
+	do {                                                                       \
+		Value v = operatorApply(operator, base[INSTRUCTION_B(instruction)],    \
+		                        base[INSTRUCTION_C(instruction)], TOKEN());    \
+		if (VALUE_TYPE(v) == VALUE_ERROR_SIGNAL)                               \
+			goto error;                                                        \
+		base[INSTRUCTION_A(instruction)] = v;                                  \
+	} while (0)
+
+// Operador aritmético com caminho rápido para inteiros
+// Com overflow o int/int cai no kernel, que reporta o erro
+#define BINARY_ARITHMETIC(operator, op, builtin)                               \
+	do {                                                                       \
+		Value *l = &base[INSTRUCTION_B(instruction)];                          \
+		Value *r = &base[INSTRUCTION_C(instruction)];                          \
+		long long result;                                                      \
+		if (VALUE_TYPE(*l) == VALUE_INTEGER &&                                 \
+		    VALUE_TYPE(*r) == VALUE_INTEGER &&                                 \
+		    !builtin(AS_INTEGER(*l), AS_INTEGER(*r), &result)) {               \
+			base[INSTRUCTION_A(instruction)] = integer(result);                \
+		} else if (VALUE_TYPE(*l) == VALUE_FLOATING &&                         \
+		           VALUE_TYPE(*r) == VALUE_FLOATING) {                         \
+			base[INSTRUCTION_A(instruction)] =                                 \
+			    floating(AS_FLOATING(*l) op AS_FLOATING(*r));                  \
+		} else {                                                               \
+			BINARY_SLOW(operator);                                             \
+		}                                                                      \
+	} while (0)
+
+// Comparação com caminho rápido para inteiros
+#define BINARY_COMPARISON(operator, op)                                        \
+	do {                                                                       \
+		Value *l = &base[INSTRUCTION_B(instruction)];                          \
+		Value *r = &base[INSTRUCTION_C(instruction)];                          \
+		if (VALUE_TYPE(*l) == VALUE_INTEGER &&                                 \
+		    VALUE_TYPE(*r) == VALUE_INTEGER) {                                 \
+			base[INSTRUCTION_A(instruction)] =                                 \
+			    boolean(AS_INTEGER(*l) op AS_INTEGER(*r));                     \
+		} else {                                                               \
+			BINARY_SLOW(operator);                                             \
+		}                                                                      \
+	} while (0)
+
+// Recarrega o estado do frame do topo
+#define LOAD_FRAME()                                                           \
+	do {                                                                       \
+		frame = &vm->frames[vm->frameCount - 1];                               \
+		closure = frame->closure;                                              \
+		chunk = closure->chunk;                                                \
+		ip = frame->ip;                                                        \
+		base = vm->stack + frame->base;                                        \
+	} while (0)
+
+#ifdef VM_COMPUTED_GOTO
+	// Cada instrução salta direto para a próxima: um salto indireto por
+	// opcode em vez de um só no topo do loop
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+	static void *const dispatchTable[256] = {
+	    [0 ... 255] = &&label_UNKNOWN,
+	    [OP_MOVE] = &&label_OP_MOVE,
+	    [OP_LOADK] = &&label_OP_LOADK,
+	    [OP_LOADI] = &&label_OP_LOADI,
+	    [OP_LOADNULL] = &&label_OP_LOADNULL,
+	    [OP_LOADBOOL] = &&label_OP_LOADBOOL,
+	    [OP_GETGLOBAL] = &&label_OP_GETGLOBAL,
+	    [OP_SETGLOBAL] = &&label_OP_SETGLOBAL,
+	    [OP_DEFGLOBAL] = &&label_OP_DEFGLOBAL,
+	    [OP_GETLOCAL] = &&label_OP_GETLOCAL,
+	    [OP_SETLOCAL] = &&label_OP_SETLOCAL,
+	    [OP_GETUPVAL] = &&label_OP_GETUPVAL,
+	    [OP_SETUPVAL] = &&label_OP_SETUPVAL,
+	    [OP_GETCELL] = &&label_OP_GETCELL,
+	    [OP_SETCELL] = &&label_OP_SETCELL,
+	    [OP_BOX] = &&label_OP_BOX,
+	    [OP_CLOSURE] = &&label_OP_CLOSURE,
+	    [OP_ADD] = &&label_OP_ADD,
+	    [OP_SUB] = &&label_OP_SUB,
+	    [OP_MUL] = &&label_OP_MUL,
+	    [OP_DIV] = &&label_OP_DIV,
+	    [OP_MOD] = &&label_OP_MOD,
+	    [OP_SHL] = &&label_OP_SHL,
+	    [OP_SHR] = &&label_OP_SHR,
+	    [OP_BAND] = &&label_OP_BAND,
+	    [OP_BOR] = &&label_OP_BOR,
+	    [OP_BXOR] = &&label_OP_BXOR,
+	    [OP_EQ] = &&label_OP_EQ,
+	    [OP_NEQ] = &&label_OP_NEQ,
+	    [OP_LT] = &&label_OP_LT,
+	    [OP_GT] = &&label_OP_GT,
+	    [OP_LTE] = &&label_OP_LTE,
+	    [OP_GTE] = &&label_OP_GTE,
+	    [OP_NEGATE] = &&label_OP_NEGATE,
+	    [OP_POSITIVE] = &&label_OP_POSITIVE,
+	    [OP_BIT_NOT] = &&label_OP_BIT_NOT,
+	    [OP_NOT] = &&label_OP_NOT,
+	    [OP_JMP] = &&label_OP_JMP,
+	    [OP_JMPIF] = &&label_OP_JMPIF,
+	    [OP_JMPIFNOT] = &&label_OP_JMPIFNOT,
+	    [OP_LOOP] = &&label_OP_LOOP,
+	    [OP_FORPREP] = &&label_OP_FORPREP,
+	    [OP_FORLOOP] = &&label_OP_FORLOOP,
+	    [OP_CALL] = &&label_OP_CALL,
+	    [OP_TAILCALL] = &&label_OP_TAILCALL,
+	    [OP_RETURN] = &&label_OP_RETURN,
+	    [OP_RETURNNULL] = &&label_OP_RETURNNULL,
+	};
+#pragma GCC diagnostic pop
+
+#define VM_DISPATCH(op) goto *dispatchTable[op];
+#define VM_CASE(op) label_##op:
+#define VM_DEFAULT label_UNKNOWN:
+#define VM_BREAK                                                               \
+	do {                                                                       \
+		instruction = *ip++;                                                   \
+		goto *dispatchTable[INSTRUCTION_OP(instruction)];                      \
+	} while (0)
+#else
+#define VM_DISPATCH(op) switch (op)
+#define VM_CASE(op) case op:
+#define VM_DEFAULT default:
+#define VM_BREAK break
+#endif
+
+	for (;;) {
+		uint32_t instruction = *ip++;
+
+		VM_DISPATCH(INSTRUCTION_OP(instruction)) {
+		VM_CASE(OP_MOVE) {
+			base[INSTRUCTION_A(instruction)] =
+			    base[INSTRUCTION_B(instruction)];
+		} VM_BREAK;
+
+		VM_CASE(OP_LOADK) {
+			base[INSTRUCTION_A(instruction)] =
+			    chunk->constants[INSTRUCTION_BX(instruction)];
+		} VM_BREAK;
+
+		VM_CASE(OP_LOADI) {
+			base[INSTRUCTION_A(instruction)] =
+			    integer(INSTRUCTION_SBX(instruction));
+		} VM_BREAK;
+
+		VM_CASE(OP_LOADNULL) {
+			base[INSTRUCTION_A(instruction)] = null();
+		} VM_BREAK;
+
+		VM_CASE(OP_LOADBOOL) {
+			base[INSTRUCTION_A(instruction)] =
+			    boolean(INSTRUCTION_B(instruction) != 0);
+		} VM_BREAK;
+
+		VM_CASE(OP_GETGLOBAL) {
+			size_t index = INSTRUCTION_BX(instruction);
+			if (VALUE_TYPE(vm->globals[index]) == VALUE_UNDEFINED) {
+				vmError(TOKEN(), "Runtime error: Undefined reference: %.*s",
+				        (int)symbolLength(vm->globalSymbols[index]),
+				        symbolName(vm->globalSymbols[index]));
+				goto error;
+			}
+			base[INSTRUCTION_A(instruction)] = vm->globals[index];
+		} VM_BREAK;
+
+		VM_CASE(OP_SETGLOBAL) {
+			size_t index = INSTRUCTION_BX(instruction);
+			if (VALUE_TYPE(vm->globals[index]) == VALUE_UNDEFINED) {
+				vmError(TOKEN(), "Runtime error: Undefined reference: %.*s",
+				        (int)symbolLength(vm->globalSymbols[index]),
+				        symbolName(vm->globalSymbols[index]));
+				goto error;
+			}
+			vm->globals[index] = base[INSTRUCTION_A(instruction)];
+		} VM_BREAK;
+
+		VM_CASE(OP_DEFGLOBAL) {
+			vm->globals[INSTRUCTION_BX(instruction)] =
+			    base[INSTRUCTION_A(instruction)];
+		} VM_BREAK;
+
+		VM_CASE(OP_GETLOCAL) {
+			Value v = base[INSTRUCTION_B(instruction)];
+			base[INSTRUCTION_A(instruction)] = v;
+			if (VALUE_TYPE(v) != VALUE_UNDEFINED)
+				ip += INSTRUCTION_C(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_SETLOCAL) {
+			Value *target = &base[INSTRUCTION_A(instruction)];
+			if (VALUE_TYPE(*target) != VALUE_UNDEFINED) {
+				*target = base[INSTRUCTION_B(instruction)];
+				ip += INSTRUCTION_C(instruction);
+			}
+		} VM_BREAK;
+
+		VM_CASE(OP_GETUPVAL) {
+			Value v = closure->upvalues[INSTRUCTION_B(instruction)]->value;
+			base[INSTRUCTION_A(instruction)] = v;
+			if (VALUE_TYPE(v) != VALUE_UNDEFINED)
+				ip += INSTRUCTION_C(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_SETUPVAL) {
+			Value *target =
+			    &closure->upvalues[INSTRUCTION_B(instruction)]->value;
+			size_t skip = INSTRUCTION_C(instruction);
+			if (!skip || VALUE_TYPE(*target) != VALUE_UNDEFINED) {
+				*target = base[INSTRUCTION_A(instruction)];
+				ip += skip;
+			}
+		} VM_BREAK;
+
+		VM_CASE(OP_GETCELL) {
+			Value v = AS_CELL(base[INSTRUCTION_B(instruction)])->value;
+			base[INSTRUCTION_A(instruction)] = v;
+			if (VALUE_TYPE(v) != VALUE_UNDEFINED)
+				ip += INSTRUCTION_C(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_SETCELL) {
+			Value *target = &AS_CELL(base[INSTRUCTION_A(instruction)])->value;
+			size_t skip = INSTRUCTION_C(instruction);
+			if (!skip || VALUE_TYPE(*target) != VALUE_UNDEFINED) {
+				*target = base[INSTRUCTION_B(instruction)];
+				ip += skip;
+			}
+		} VM_BREAK;
+
+		VM_CASE(OP_BOX) {
+			Value *target = &base[INSTRUCTION_A(instruction)];
+			Cell *cell = cellCreate(*target);
+			if (!cell) {
+				vmError(TOKEN(), "Internal error: Failed to alloc cell");
+				goto error;
+			}
+			*target = cellValue(cell);
+		} VM_BREAK;
+
+		VM_CASE(OP_CLOSURE) {
+			Chunk *child = chunk->children[INSTRUCTION_BX(instruction)];
+			Closure *created = closureCreate(child);
+			if (!created) {
+				vmError(TOKEN(), "Internal error: Failed to alloc closure");
+				goto error;
+			}
+
+			for (size_t i = 0; i < child->upvalueCount; i++) {
+				UpvalueInfo info = child->upvalues[i];
+				created->upvalues[i] = info.fromParent
+				                           ? AS_CELL(base[info.index])
+				                           : closure->upvalues[info.index];
+			}
+
+			base[INSTRUCTION_A(instruction)] = closureValue(created);
+		} VM_BREAK;
+
+		VM_CASE(OP_ADD) {
+			BINARY_ARITHMETIC(OPERATOR_ADD, +, __builtin_add_overflow);
+		} VM_BREAK;
+
+		VM_CASE(OP_SUB) {
+			BINARY_ARITHMETIC(OPERATOR_SUB, -, __builtin_sub_overflow);
+		} VM_BREAK;
+
+		VM_CASE(OP_MUL) {
+			BINARY_ARITHMETIC(OPERATOR_MUL, *, __builtin_mul_overflow);
+		} VM_BREAK;
+
+		VM_CASE(OP_DIV) {
+			BINARY_SLOW(OPERATOR_DIV);
+		} VM_BREAK;
+
+		VM_CASE(OP_MOD) {
+			BINARY_SLOW(OPERATOR_MOD);
+		} VM_BREAK;
+
+		VM_CASE(OP_SHL) {
+			BINARY_SLOW(OPERATOR_SHL);
+		} VM_BREAK;
+
+		VM_CASE(OP_SHR) {
+			BINARY_SLOW(OPERATOR_SHR);
+		} VM_BREAK;
+
+		VM_CASE(OP_BAND) {
+			BINARY_SLOW(OPERATOR_BAND);
+		} VM_BREAK;
+
+		VM_CASE(OP_BOR) {
+			BINARY_SLOW(OPERATOR_BOR);
+		} VM_BREAK;
+
+		VM_CASE(OP_BXOR) {
+			BINARY_SLOW(OPERATOR_BXOR);
+		} VM_BREAK;
+
+		VM_CASE(OP_EQ) {
+			BINARY_COMPARISON(OPERATOR_EQ, ==);
+		} VM_BREAK;
+
+		VM_CASE(OP_NEQ) {
+			BINARY_COMPARISON(OPERATOR_NEQ, !=);
+		} VM_BREAK;
+
+		VM_CASE(OP_LT) {
+			BINARY_COMPARISON(OPERATOR_LT, <);
+		} VM_BREAK;
+
+		VM_CASE(OP_GT) {
+			BINARY_COMPARISON(OPERATOR_GT, >);
+		} VM_BREAK;
+
+		VM_CASE(OP_LTE) {
+			BINARY_COMPARISON(OPERATOR_LTE, <=);
+		} VM_BREAK;
+
+		VM_CASE(OP_GTE) {
+			BINARY_COMPARISON(OPERATOR_GTE, >=);
+		} VM_BREAK;
+
+		VM_CASE(OP_NEGATE)
+		VM_CASE(OP_POSITIVE)
+		VM_CASE(OP_BIT_NOT)
+		VM_CASE(OP_NOT) {
+			static const TokenType unaryTokens[] = {
+			    [OP_NEGATE] = TOKEN_MINUS,
+			    [OP_POSITIVE] = TOKEN_PLUS,
+			    [OP_BIT_NOT] = TOKEN_BIT_NOT,
+			    [OP_NOT] = TOKEN_NOT,
+			};
+
+			Value v = operatorUnary(unaryTokens[INSTRUCTION_OP(instruction)],
+			                        base[INSTRUCTION_B(instruction)], TOKEN());
+			if (VALUE_TYPE(v) == VALUE_ERROR_SIGNAL)
+				goto error;
+			base[INSTRUCTION_A(instruction)] = v;
+		} VM_BREAK;
+
+		VM_CASE(OP_JMP) {
+			ip += INSTRUCTION_SBX(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_JMPIF) {
+			Value *condition = &base[INSTRUCTION_A(instruction)];
+			bool truth = VALUE_TYPE(*condition) == VALUE_BOOLEAN
+			                 ? AS_BOOLEAN(*condition)
+			                 : isTrue(*condition);
+			if (truth)
+				ip += INSTRUCTION_SBX(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_JMPIFNOT) {
+			Value *condition = &base[INSTRUCTION_A(instruction)];
+			bool truth = VALUE_TYPE(*condition) == VALUE_BOOLEAN
+			                 ? AS_BOOLEAN(*condition)
+			                 : isTrue(*condition);
+			if (!truth)
+				ip += INSTRUCTION_SBX(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_LOOP) {
+			// Loop sem chamadas também precisa deixar o gc rodar
+			gcCheckpoint();
+			ip += INSTRUCTION_SBX(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_FORPREP) {
+			Value *counter = &base[INSTRUCTION_A(instruction)];
+			if (VALUE_TYPE(counter[0]) != VALUE_INTEGER ||
+			    VALUE_TYPE(counter[1]) != VALUE_INTEGER) {
+				vmError(TOKEN(),
+				        "Runtime error: Range bounds must be integers");
+				goto error;
+			}
+			if (AS_INTEGER(counter[0]) >= AS_INTEGER(counter[1]))
+				ip += INSTRUCTION_SBX(instruction);
+		} VM_BREAK;
+
+		VM_CASE(OP_FORLOOP) {
+			// O limite é inteiro, então o contador nunca passa dele
+			Value *counter = &base[INSTRUCTION_A(instruction)];
+			long long next = AS_INTEGER(counter[0]) + 1;
+			if (next < AS_INTEGER(counter[1])) {
+				counter[0] = integer(next);
+				gcCheckpoint();
+				ip += INSTRUCTION_SBX(instruction);
+			}
+		} VM_BREAK;
+
+		VM_CASE(OP_CALL) {
+			// Tudo que está vivo está nos registradores ou nos globais
+			gcCheckpoint();
+
+			Value *callee = &base[INSTRUCTION_A(instruction)];
+			size_t argc = INSTRUCTION_B(instruction);
+
+			if (VALUE_TYPE(*callee) == VALUE_FUNCTION_CLOSURE) {
+				Closure *called = AS_CLOSURE(*callee);
+				Chunk *calledChunk = called->chunk;
+
+				if (argc != calledChunk->paramCount) {
+					vmError(TOKEN(), "Runtime error: Invalid parameters");
+					goto error;
+				}
+
+				size_t newBase =
+				    (size_t)(base - vm->stack) + INSTRUCTION_A(instruction) + 1;
+				frame->ip = ip;
+
+				if (!vmReserve(vm, newBase + calledChunk->registerCount) ||
+				    !vmPushFrame(vm, called, newBase)) {
+					vmError(TOKEN(), "Runtime error: Stack overflow");
+					goto error;
+				}
+
+				LOAD_FRAME();
+				for (size_t i = argc; i < chunk->registerCount; i++)
+					base[i] = undefined();
+			} else if (VALUE_TYPE(*callee) == VALUE_FUNCTION_BUILTIN) {
+				Value v =
+				    AS_BUILTIN(*callee)(callee + 1, argc, vm->arena, NULL);
+				if (VALUE_TYPE(v) == VALUE_ERROR_SIGNAL)
+					goto error;
+				*callee = v;
+			} else {
+				vmError(TOKEN(),
+				        "Runtime error: Called something that isn't a "
+				        "function");
+				goto error;
+			}
+		} VM_BREAK;
+
+		VM_CASE(OP_TAILCALL) {
+			gcCheckpoint();
+
+			Value *callee = &base[INSTRUCTION_A(instruction)];
+			size_t argc = INSTRUCTION_B(instruction);
+			Value v;
+
+			if (VALUE_TYPE(*callee) == VALUE_FUNCTION_CLOSURE) {
+				Closure *called = AS_CLOSURE(*callee);
+				Chunk *calledChunk = called->chunk;
+
+				if (argc != calledChunk->paramCount) {
+					vmError(TOKEN(), "Runtime error: Invalid parameters");
+					goto error;
+				}
+
+				// Callee e args descem para onde estava o callee deste frame
+				memmove(base - 1, callee, (argc + 1) * sizeof(Value));
+				frame->closure = called;
+				frame->ip = calledChunk->code;
+
+				if (!vmReserve(vm, frame->base + calledChunk->registerCount)) {
+					vmError(TOKEN(), "Runtime error: Stack overflow");
+					goto error;
+				}
+
+				LOAD_FRAME();
+				for (size_t i = argc; i < chunk->registerCount; i++)
+					base[i] = undefined();
+				VM_BREAK;
+			} else if (VALUE_TYPE(*callee) == VALUE_FUNCTION_BUILTIN) {
+				v = AS_BUILTIN(*callee)(callee + 1, argc, vm->arena, NULL);
+				if (VALUE_TYPE(v) == VALUE_ERROR_SIGNAL)
+					goto error;
+			} else {
+				vmError(TOKEN(),
+				        "Runtime error: Called something that isn't a "
+				        "function");
+				goto error;
+			}
+
+			// Built-in: retorna o resultado direto
+			vm->frameCount--;
+			if (vm->frameCount == 0)
+				return v;
+
+			base[-1] = v;
+			LOAD_FRAME();
+		} VM_BREAK;
+
+		VM_CASE(OP_RETURN)
+		VM_CASE(OP_RETURNNULL) {
+			Value v = INSTRUCTION_OP(instruction) == OP_RETURN
+			              ? base[INSTRUCTION_A(instruction)]
+			              : null();
+
+			vm->frameCount--;
+			if (vm->frameCount == 0)
+				return v;
+
+			base[-1] = v; // Registrador do callee no frame de quem chamou
+			LOAD_FRAME();
+		} VM_BREAK;
+
+		VM_DEFAULT {
+			vmError(TOKEN(), "Internal error: Unknown opcode %d",
+			        INSTRUCTION_OP(instruction));
+			goto error;
+		}
+		}
+	}
+
+error:
+	vm->frameCount = 0;
+	return errorSignal();
+
+#undef TOKEN
+#undef BINARY_SLOW
+#undef BINARY_ARITHMETIC
+#undef BINARY_COMPARISON
+#undef LOAD_FRAME
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef VM_DEFAULT
+#undef VM_BREAK
+}
+
+// Executa o chunk principal
+Value vmRun(VM *vm, Chunk *chunk) {
+	if (!vm || !chunk) {
+		logger(LOG_ERROR, "Internal error: Failed to execute code: no have "
+		                  "vm or chunk\n");
+		return integer(-1);
+	}
+
+	Closure *script = closureCreate(chunk);
+	if (!script || !vmReserve(vm, chunk->registerCount) ||
+	    !vmPushFrame(vm, script, 0)) {
+		logger(LOG_ERROR, "Internal error: Failed to start vm\n");
+		return integer(-1);
+	}
+
+	for (size_t i = 0; i < chunk->registerCount; i++)
+		vm->stack[i] = null();
+
+	vm->script = chunk;
+	gcSetRoots(vmMarkRoots, vm);
+	Value ret = vmExecute(vm);
+	gcSetRoots(NULL, NULL);
+	vm->script = NULL;
+	return ret;
+}
+
+// Destrói uma VM
+// Closures e cells ficam com o GC
+void vmDestroy(VM *vm) {
+	if (!vm)
+		return;
+
+	free(vm->stack);
+	free(vm->frames);
+	free(vm->globals);
+	free(vm->globalSymbols);
+	free(vm);
+}
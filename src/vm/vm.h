@@ -0,0 +1,58 @@
+/**
+ * vm.h
+ * Criado por Matheus Leme Da Silva
+ * Licença MIT
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../eval/arena.h"
+#include "../eval/gc.h"
+#include "../eval/value.h"
+#include "chunk.h"
+
+// Variável capturada por uma closure
+typedef struct Cell {
+	GcObject object;
+	Value value;
+} Cell;
+
+// Função da VM: chunk + variáveis capturadas
+typedef struct Closure {
+	GcObject object;
+	Chunk *chunk;
+	size_t upvalueCount;
+	Cell *upvalues[];
+} Closure;
+
+// Chamada em andamento
+typedef struct {
+	Closure *closure;
+	const uint32_t *ip;
+	size_t base; // Índice do registrador 0 da função na pilha
+} CallFrame;
+
+// VM de registradores
+typedef struct VM {
+	Value *stack;
+	size_t stackSize;
+
+	CallFrame *frames;
+	size_t frameCount;
+	size_t frameCapacity;
+
+	Value *globals;
+	Symbol *globalSymbols;
+	size_t globalCount;
+	size_t globalCapacity;
+
+	Chunk *script; // Chunk em execução, para marcar as constantes
+	Arena *arena;
+} VM;
+
+VM *vmCreate(Arena *arena);
+size_t vmGlobalIndex(VM *vm, Symbol symbol);
+Value vmRun(VM *vm, Chunk *chunk);
+void vmDestroy(VM *vm);